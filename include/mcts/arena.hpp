@@ -0,0 +1,900 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <chess/chess.hpp>
+#include <mcts/node.hpp>
+#include <mcts/instrument.hpp>
+#include <mcts/misc.hpp>
+#include <mcts/rng.hpp>
+#include <mcts/selection.hpp>
+#include <mcts/snapshot.hpp>
+#include <mcts/transposition.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <float.h>
+#include <math.h>
+
+// Flat search tree where nodes live in per-search pools instead of a shared_ptr graph
+namespace arena
+{
+    using index_type = std::uint32_t;
+    constexpr index_type null_index = std::numeric_limits<index_type>::max();
+    using node::same_move;
+
+    // Pool of T handed out in fixed size blocks
+    // Indices stay valid while the pool grows and reset() releases everything at once
+    template<typename T, size_t BLOCK_BITS = 16, size_t MAX_BLOCKS = 4096>
+    class Pool
+    {
+        public:
+            static constexpr size_t BLOCK_SIZE = size_t{1} << BLOCK_BITS;
+
+            Pool() = default;
+            Pool(const Pool&) = delete;
+            Pool& operator=(const Pool&) = delete;
+            ~Pool()
+            {
+                reset();
+            }
+
+            // Construct count contiguous elements and return the index of the first one
+            // A range never straddles two blocks
+            template<typename... Args>
+            index_type allocate(size_t count, const Args&... args)
+            {
+                size_t offset = next & (BLOCK_SIZE - 1);
+                if (offset != 0 && offset + count > BLOCK_SIZE)
+                {
+                    block_used[next >> BLOCK_BITS] = offset;
+                    next += BLOCK_SIZE - offset;
+                }
+                size_t block = next >> BLOCK_BITS;
+                if (!blocks[block])
+                {
+                    blocks[block].reset(new Storage[BLOCK_SIZE]);
+                    ++n_blocks;
+                }
+                index_type first = static_cast<index_type>(next);
+                for (size_t i = 0; i < count; ++i)
+                {
+                    new (address(first + i)) T(args...);
+                }
+                next += count;
+                n_elements.store(n_elements.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+                block_used[block] = next - block * BLOCK_SIZE;
+                return first;
+            }
+
+            inline T& operator[](index_type idx)
+            {
+                return *std::launder(reinterpret_cast<T*>(address(idx)));
+            }
+
+            inline const T& operator[](index_type idx) const
+            {
+                return *std::launder(reinterpret_cast<const T*>(address(idx)));
+            }
+
+            // Drop every element, blocks are kept for the next search
+            // O(1) when T is trivially destructible
+            void reset()
+            {
+                if constexpr (!std::is_trivially_destructible_v<T>)
+                {
+                    for (size_t block = 0; block * BLOCK_SIZE < next; ++block)
+                    {
+                        for (size_t i = 0; i < block_used[block]; ++i)
+                        {
+                            (*this)[static_cast<index_type>(block * BLOCK_SIZE + i)].~T();
+                        }
+                    }
+                }
+                next = 0;
+                n_elements.store(0, std::memory_order_relaxed);
+            }
+
+            // Amount of constructed elements, may be read while another thread allocates
+            size_t size() const
+            {
+                return n_elements.load(std::memory_order_relaxed);
+            }
+
+            // Exchange contents with other in O(1)
+            void swap(Pool& other)
+            {
+                std::swap(blocks, other.blocks);
+                std::swap(block_used, other.block_used);
+                std::swap(next, other.next);
+                size_t elements = n_elements.load(std::memory_order_relaxed);
+                n_elements.store(other.n_elements.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                other.n_elements.store(elements, std::memory_order_relaxed);
+                std::swap(n_blocks, other.n_blocks);
+            }
+
+            // Bytes currently reserved by the pool
+            size_t reserved_bytes() const
+            {
+                return n_blocks * BLOCK_SIZE * sizeof(T);
+            }
+
+        private:
+            using Storage = std::aligned_storage_t<sizeof(T), alignof(T)>;
+
+            inline Storage* address(index_type idx) const
+            {
+                return &blocks[idx >> BLOCK_BITS][idx & (BLOCK_SIZE - 1)];
+            }
+
+            std::array<std::unique_ptr<Storage[]>, MAX_BLOCKS> blocks{};
+            std::array<size_t, MAX_BLOCKS> block_used{};
+            size_t next{0};
+            std::atomic<size_t> n_elements{0};
+            size_t n_blocks{0};
+    };
+
+    // Search tree node, children are the index range [first_child, first_child + n_children)
+    // Positions are not stored, only nodes with a cached state point into the state pool
+    // Statistics are atomics so several workers can share one tree
+    // t is the score from the side of the move into the node, so every level selects the child best for its mover
+    // A child that transposes into a node found in the transposition table links to it
+    // and uses the statistics and children of that node
+    // Stats holds what the selection policy keeps per node, an empty Stats takes no space
+    template<typename Stats>
+    struct BasicNode
+    {
+        BasicNode(index_type parent, chess::move move)
+            : move{move},
+            parent{parent}
+        {}
+
+        enum expansion : std::uint8_t { unexpanded, expanding, expanded };
+
+        // Children may only be read once the node is expanded
+        inline bool has_children() const
+        {
+            return expand_state.load(std::memory_order_acquire) == expanded && n_children > 0;
+        }
+
+        chess::move move;
+        index_type parent;
+        index_type first_child = null_index;
+        index_type link = null_index;
+        std::atomic<index_type> state_idx{null_index};
+        std::uint16_t n_children = 0;
+        std::atomic<std::uint8_t> expand_state{unexpanded};
+        std::atomic<bool> is_terminal_node{false};
+        std::atomic<double> t{0};
+        std::atomic<int> n{0};
+        std::atomic<int> virtual_loss{0};
+        [[no_unique_address]] Stats stats{};
+    };
+
+    // Per worker selection state, the selected path, the position of its leaf, the rollout state
+    // and the scratch statistics of the level being selected and of AMAF updates
+    // The path holds the child slots that were walked, which may link to shared nodes
+    struct Cursor
+    {
+        std::vector<index_type> path{};
+        chess::position state = chess::position::from_fen(chess::position::fen_start);
+        node::Playout playout{};
+        selection::ChildStats stats{};
+        std::array<std::vector<std::uint64_t>, 2> amaf_keys{};
+    };
+
+    // Arena backed counterpart of node::Node
+    // Positions are rebuilt by replaying moves from the deepest cached ancestor of the selected leaf
+    // A node caches its position once it has been visited cache_visits times, 0 caches every node
+    // Several workers may search the tree at once, each with its own Cursor
+    // With a table_size the tree becomes a graph where transpositions share one node
+    // Selection is one of the policies of selection.hpp, its formula is inlined into traverse
+    template<typename Selection = selection::UCB1>
+    class BasicTree
+    {
+        public:
+            using Node = BasicNode<typename Selection::Stats>;
+
+            BasicTree(chess::side player_side, int cache_visits = DEFAULT_CACHE_VISITS, size_t table_size = 0)
+                : player_side{player_side},
+                cache_visits{cache_visits},
+                table{table_size}
+            {}
+
+            // Drop the previous tree and create a root for state
+            index_type set_root(const chess::position& state)
+            {
+                clear();
+                root_turn = state.get_turn();
+                nodes.allocate(1, null_index, chess::move());
+                nodes[root].state_idx.store(states.allocate(1, state), std::memory_order_relaxed);
+                if (table.enabled())
+                {
+                    root_key.emplace(state);
+                    table.store(root_key->value, 0, root, [this](index_type idx) { return visits(idx); });
+                }
+                return root;
+            }
+
+            // Create a root for state, point cursor at it and expand it
+            void start(Cursor& cursor, const chess::position& state)
+            {
+                set_root(state);
+                cursor.path.assign(1, root);
+                cursor.state = state;
+                expand(cursor);
+            }
+
+            // Run one selection, expansion, rollout and backpropagation step
+            // With stats the step is counted there and every SAMPLE_PERIOD-th one is timed, expansion counts as selection
+            // Returns false when the selected leaf is a terminal state
+            template<node::RolloutPolicy Policy>
+            bool iterate(Cursor& cursor, Policy& rollout_policy, instrument::SearchStats* stats = nullptr)
+            {
+                bool sampled = stats && stats->next_iteration();
+                {
+                    instrument::ScopedTimer timer{stats, instrument::select_phase, sampled};
+                    if (!select(cursor)) return false;
+                }
+                std::uint64_t plies = cursor.playout.plies;
+                double t;
+                {
+                    instrument::ScopedTimer timer{stats, instrument::rollout_phase, sampled};
+                    t = rollout_policy(cursor.state, player_side, cursor.playout);
+                }
+                if (stats)
+                {
+                    if (sampled) stats->add_depth(cursor.path.size() - 1);
+                    stats->add_rollouts(1, cursor.playout.plies - plies);
+                }
+                instrument::ScopedTimer timer{stats, instrument::backprop_phase, sampled};
+                update(cursor, t);
+                return true;
+            }
+
+            // Select the leaf to roll out into cursor, expanding it once it has been visited
+            // A leaf is checked for mate or stalemate on its first visit, a terminal one is scored and selection restarts
+            // Returns false if the search is over, the leaf of cursor then needs no update
+            // Policies with AMAF statistics get the moves of the next rollout recorded in the playout of cursor
+            bool select(Cursor& cursor)
+            {
+                cursor.playout.clear_moves();
+                cursor.playout.record_moves = Selection::uses_amaf;
+                while (true)
+                {
+                    index_type current_node = resolve(traverse(cursor));
+                    if (is_over(cursor))
+                    {
+                        revert_virtual_loss(cursor);
+                        return false;
+                    }
+                    if (visits(current_node) != 0 && expand(cursor))
+                    {
+                        current_node = resolve(descend(cursor, nodes[current_node].first_child));
+                    }
+                    if (visits(current_node) != 0 || !score_terminal(cursor)) return true;
+                }
+            }
+
+            // Add the rollout score t for player_side to the leaf of cursor and its path
+            void update(Cursor& cursor, double t)
+            {
+                backpropagate(cursor, t);
+                if constexpr (Selection::uses_amaf) update_amaf(cursor, t);
+                revert_virtual_loss(cursor);
+            }
+
+            // Find the child of parent reached by move, null_index if it is not in the tree
+            index_type find_child(index_type parent, const chess::move& move) const
+            {
+                if (!nodes[parent].has_children()) return null_index;
+                const Node& parent_node = nodes[parent];
+                for (index_type i = parent_node.first_child; i < parent_node.first_child + parent_node.n_children; ++i)
+                {
+                    if (same_move(nodes[i].move, move)) return i;
+                }
+                return null_index;
+            }
+
+            // Make the subtree reached by playing moves from the root the new root for state
+            // The subtree is copied into the spare pools and the rest of the tree is released
+            // The copy is O(kept nodes) per call, which is still far below searching them again
+            // Links out of the subtree become leaves that keep their statistics
+            // Returns false and leaves the tree untouched if the subtree was never expanded
+            bool reroot(const std::vector<chess::move>& moves, Cursor& cursor, const chess::position& state)
+            {
+                if (nodes.size() == 0) return false;
+                index_type new_root = root;
+                for (const chess::move& move : moves)
+                {
+                    new_root = find_child(new_root, move);
+                    if (new_root == null_index) return false;
+                    new_root = resolve(new_root);
+                }
+
+                spare_nodes.reset();
+                spare_states.reset();
+                std::vector<std::pair<index_type, index_type>> queue{};
+                spare_nodes.allocate(1, null_index, chess::move());
+                copy_node(new_root, root);
+                index_type root_state = spare_nodes[root].state_idx.load(std::memory_order_relaxed);
+                if (root_state == null_index) spare_nodes[root].state_idx.store(spare_states.allocate(1, state), std::memory_order_relaxed);
+                else spare_states[root_state] = state;
+                queue.emplace_back(new_root, root);
+                for (size_t i = 0; i < queue.size(); ++i)
+                {
+                    auto [old_idx, new_idx] = queue[i];
+                    const Node& old_node = nodes[old_idx];
+                    if (!old_node.has_children()) continue;
+                    index_type first = spare_nodes.allocate(old_node.n_children, new_idx, chess::move());
+                    spare_nodes[new_idx].first_child = first;
+                    for (index_type j = 0; j < old_node.n_children; ++j)
+                    {
+                        copy_node(old_node.first_child + j, first + j);
+                        if (nodes[old_node.first_child + j].link == null_index) queue.emplace_back(old_node.first_child + j, first + j);
+                    }
+                }
+                nodes.swap(spare_nodes);
+                states.swap(spare_states);
+                root_turn = state.get_turn();
+                spare_nodes.reset();
+                spare_states.reset();
+                table.clear();
+                if (table.enabled())
+                {
+                    root_key.emplace(state);
+                    table.store(root_key->value, 0, root, [this](index_type idx) { return visits(idx); });
+                }
+
+                cursor.path.assign(1, root);
+                cursor.state = state;
+                if (nodes[root].expand_state.load(std::memory_order_relaxed) == Node::unexpanded) expand(cursor);
+                return true;
+            }
+
+            // The tree in breadth first order like reroot copies it, a transposition becomes a leaf with the statistics it links to
+            // Call between searches
+            snapshot::Snapshot save() const
+            {
+                snapshot::Snapshot saved{};
+                if (nodes.size() == 0) return saved;
+                saved.root_state = states[nodes[root].state_idx.load(std::memory_order_relaxed)];
+                saved.root_turn = root_turn;
+                saved.player_side = player_side;
+                saved.root_hash = transposition::hash(saved.root_state);
+                std::vector<index_type> order{root};
+                saved.nodes.reserve(nodes.size());
+                saved.nodes.emplace_back();
+                for (size_t i = 0; i < order.size(); ++i)
+                {
+                    const Node& slot = nodes[order[i]];
+                    const Node& source = nodes[resolve(order[i])];
+                    snapshot::SavedNode& target = saved.nodes[i];
+                    target.move = slot.move;
+                    target.t = source.t.load(std::memory_order_relaxed);
+                    target.n = source.n.load(std::memory_order_relaxed);
+                    Selection::save(source.stats, target.extra);
+                    if (source.is_terminal_node.load(std::memory_order_relaxed)) target.flags |= snapshot::SavedNode::terminal;
+                    if (slot.link != null_index) continue;
+                    if (slot.expand_state.load(std::memory_order_relaxed) == Node::expanded) target.flags |= snapshot::SavedNode::expanded;
+                    if (!slot.has_children()) continue;
+                    target.first_child = static_cast<std::uint32_t>(order.size());
+                    target.n_children = slot.n_children;
+                    for (index_type j = 0; j < slot.n_children; ++j)
+                    {
+                        order.push_back(slot.first_child + j);
+                        saved.nodes.emplace_back();
+                        saved.nodes.back().parent = static_cast<std::uint32_t>(i);
+                    }
+                }
+                return saved;
+            }
+
+            // Replace the tree with saved and point cursor at its root
+            // Returns false and keeps the tree if saved was not searched from state for player_side
+            // Positions below the root are rebuilt by replaying moves, the transposition table starts over
+            bool restore(const snapshot::Snapshot& saved, Cursor& cursor, const chess::position& state)
+            {
+                if (saved.nodes.empty() || saved.player_side != player_side || saved.root_turn != state.get_turn()
+                    || saved.root_hash != transposition::hash(state))
+                {
+                    return false;
+                }
+                set_root(state);
+                std::vector<index_type> loaded(saved.nodes.size(), null_index);
+                loaded[0] = root;
+                for (size_t i = 0; i < saved.nodes.size(); ++i)
+                {
+                    const snapshot::SavedNode& source = saved.nodes[i];
+                    Node& target = nodes[loaded[i]];
+                    target.t.store(source.t, std::memory_order_relaxed);
+                    target.n.store(source.n, std::memory_order_relaxed);
+                    Selection::restore(target.stats, source.extra);
+                    target.is_terminal_node.store((source.flags & snapshot::SavedNode::terminal) != 0, std::memory_order_relaxed);
+                    if (source.n_children > 0)
+                    {
+                        index_type first = nodes.allocate(source.n_children, loaded[i], chess::move());
+                        for (index_type j = 0; j < source.n_children; ++j)
+                        {
+                            loaded[source.first_child + j] = first + j;
+                            nodes[first + j].move = saved.nodes[source.first_child + j].move;
+                        }
+                        nodes[loaded[i]].first_child = first;
+                        nodes[loaded[i]].n_children = source.n_children;
+                    }
+                    if (source.flags & snapshot::SavedNode::expanded) nodes[loaded[i]].expand_state.store(Node::expanded, std::memory_order_relaxed);
+                }
+                cursor.path.assign(1, root);
+                cursor.state = state;
+                if (nodes[root].expand_state.load(std::memory_order_relaxed) == Node::unexpanded) expand(cursor);
+                return true;
+            }
+
+            // Release every node in O(1), memory is kept for the next search
+            void clear()
+            {
+                nodes.reset();
+                states.reset();
+                table.clear();
+            }
+
+            // Node holding the statistics of slot idx
+            inline index_type resolve(index_type idx) const
+            {
+                index_type link = nodes[idx].link;
+                return link != null_index ? link : idx;
+            }
+
+            // Visits of node idx
+            inline int visits(index_type idx) const
+            {
+                return nodes[idx].n.load(std::memory_order_relaxed);
+            }
+
+            // Expand the leaf of cursor, children are laid out next to each other
+            // Unlike node::Node every child is allocated here, selection finds them by first_child and n_children
+            // Children become visible to other workers once they are all initialized
+            // Children found in the transposition table link to the node stored there
+            // Children are not checked for mate or stalemate here, select does that on their first visit
+            // A leaf without moves becomes terminal
+            // Returns false if another worker already expanded or is expanding it
+            bool expand(Cursor& cursor)
+            {
+                index_type idx = resolve(cursor.path.back());
+                std::uint16_t depth = static_cast<std::uint16_t>(cursor.path.size());
+                std::uint8_t expected = Node::unexpanded;
+                if (!nodes[idx].expand_state.compare_exchange_strong(expected, Node::expanding, std::memory_order_acq_rel))
+                {
+                    return false;
+                }
+                std::vector<chess::move> available_moves{cursor.state.moves()};
+                if (available_moves.empty())
+                {
+                    nodes[idx].is_terminal_node.store(true, std::memory_order_relaxed);
+                    nodes[idx].expand_state.store(Node::expanded, std::memory_order_release);
+                    return false;
+                }
+                index_type first;
+                {
+                    std::lock_guard<std::mutex> lock{allocation_mutex};
+                    first = nodes.allocate(available_moves.size(), idx, chess::move());
+                }
+                for (size_t i = 0; i < available_moves.size(); ++i)
+                {
+                    nodes[first + static_cast<index_type>(i)].move = available_moves[i];
+                }
+                nodes[idx].first_child = first;
+                nodes[idx].n_children = static_cast<std::uint16_t>(available_moves.size());
+                // Keys of the children follow the moves of the path from the key of the root
+                std::optional<transposition::Key> key{};
+                if (table.enabled())
+                {
+                    key = root_key;
+                    for (size_t i = 1; i < cursor.path.size(); ++i) key->play(nodes[cursor.path[i]].move);
+                }
+                for (size_t i = 0; i < available_moves.size(); ++i)
+                {
+                    index_type child_idx = first + static_cast<index_type>(i);
+                    Node& child = nodes[child_idx];
+                    chess::position child_state = cursor.state;
+                    chess::undo undo = child_state.make_move(child.move);
+                    Selection::on_expand(child.stats, undo.capture != chess::piece::piece_none);
+                    if (table.enabled())
+                    {
+                        transposition::Key child_key = *key;
+                        child_key.play(child.move);
+                        index_type existing = table.probe(child_key.value, depth);
+                        if (existing != null_index)
+                        {
+                            child.link = existing;
+                            continue;
+                        }
+                        table.store(child_key.value, depth, child_idx, [this](index_type node_idx) { return visits(node_idx); });
+                    }
+                    if (cache_visits == 0)
+                    {
+                        cache_state(child, child_state);
+                    }
+                }
+                nodes[idx].expand_state.store(Node::expanded, std::memory_order_release);
+                return true;
+            }
+
+            // Descend from the root by UCB1 until a leaf is reached and rebuild the leaf position
+            // Nodes whose children are all terminal become terminal and selection restarts
+            // With virtual_loss set every node on the selected path gets a pending loss, which counts as a lost visit
+            index_type traverse(Cursor& cursor)
+            {
+                cursor.path.assign(1, root);
+                while (nodes[resolve(cursor.path.back())].has_children())
+                {
+                    const Node& current_node = nodes[resolve(cursor.path.back())];
+                    int parent_n = current_node.n.load(std::memory_order_relaxed) + current_node.virtual_loss.load(std::memory_order_relaxed);
+                    selection::ChildStats& stats = cursor.stats;
+                    stats.resize(current_node.n_children);
+                    for (index_type i = 0; i < current_node.n_children; ++i)
+                    {
+                        const Node& child = nodes[resolve(current_node.first_child + i)];
+                        int loss = child.virtual_loss.load(std::memory_order_relaxed);
+                        stats.n[i] = child.n.load(std::memory_order_relaxed) + loss;
+                        stats.t[i] = child.t.load(std::memory_order_relaxed) - loss * WIN_SCORE();
+                        stats.blocked[i] = child.is_terminal_node.load(std::memory_order_relaxed);
+                        Selection::load(stats, i, child.stats);
+                        if (loss != 0) Selection::pending(stats, i, loss, WIN_SCORE());
+                    }
+                    size_t best_offset = Selection::best(stats, parent_n, selection::Params{node::Node::UCB1_CONST, WIN_SCORE()});
+                    index_type best = best_offset == stats.size() ? null_index : current_node.first_child + static_cast<index_type>(best_offset);
+                    if (best == null_index)
+                    {
+                        nodes[resolve(cursor.path.back())].is_terminal_node.store(true, std::memory_order_relaxed);
+                        if (cursor.path.size() == 1) break;
+                        revert_virtual_loss(cursor);
+                        cursor.path.assign(1, root);
+                        continue;
+                    }
+                    if (virtual_loss) nodes[resolve(best)].virtual_loss.fetch_add(1, std::memory_order_relaxed);
+                    cursor.path.push_back(best);
+                }
+                rebuild_state(cursor);
+                return cursor.path.back();
+            }
+
+            // Step from the leaf of cursor to one of its children
+            index_type descend(Cursor& cursor, index_type child)
+            {
+                if (virtual_loss) nodes[resolve(child)].virtual_loss.fetch_add(1, std::memory_order_relaxed);
+                cursor.path.push_back(child);
+                cursor.state.make_move(nodes[child].move);
+                return child;
+            }
+
+            // Remove the pending losses that traverse and descend put on the path of cursor
+            void revert_virtual_loss(const Cursor& cursor)
+            {
+                if (!virtual_loss) return;
+                for (size_t i = 1; i < cursor.path.size(); ++i)
+                {
+                    nodes[resolve(cursor.path[i])].virtual_loss.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+
+            // Add score t for player_side and a visit to every node on the path of cursor, from the leaf up
+            // The sign flips every level, each node gets the score from the side of the move into it
+            // Following the path instead of parents updates shared nodes once per visit
+            void backpropagate(const Cursor& cursor, double t)
+            {
+                double signed_t = score_sign(cursor.path.size() - 1) * t;
+                for (size_t i = cursor.path.size(); i-- > 0; signed_t = -signed_t)
+                {
+                    add_visit(nodes[resolve(cursor.path[i])], signed_t);
+                }
+            }
+
+            // Sign that turns a score for player_side into one for the side that moved into the node at depth
+            // Root children are reached by a move of the side to move at the root
+            inline double score_sign(size_t depth) const
+            {
+                return ((depth & 1) != 0) == (root_turn == player_side) ? 1.0 : -1.0;
+            }
+
+            // Give every child on the path the AMAF score t, from the side of its move, if that move was played later by the same side
+            // Walking up from the leaf, the move into each node joins the keys of the side that played it
+            void update_amaf(Cursor& cursor, double t)
+            {
+                std::array<std::vector<std::uint64_t>, 2>& keys = cursor.amaf_keys;
+                for (int side = 0; side < 2; ++side)
+                {
+                    keys[side].clear();
+                    for (const chess::move& move : cursor.playout.moves[side]) keys[side].push_back(move_key(move));
+                    std::sort(keys[side].begin(), keys[side].end());
+                }
+                const size_t leaf = cursor.path.size() - 1;
+                double child_t = score_sign(leaf + 1) * t;
+                for (size_t i = leaf + 1; i-- > 0; child_t = -child_t)
+                {
+                    std::vector<std::uint64_t>& side_keys = keys[(leaf - i) & 1];
+                    if (i < leaf)
+                    {
+                        std::uint64_t key = move_key(nodes[cursor.path[i + 1]].move);
+                        side_keys.insert(std::upper_bound(side_keys.begin(), side_keys.end(), key), key);
+                    }
+                    const Node& current_node = nodes[resolve(cursor.path[i])];
+                    if (!current_node.has_children()) continue;
+                    for (index_type j = current_node.first_child; j < current_node.first_child + current_node.n_children; ++j)
+                    {
+                        if (std::binary_search(side_keys.begin(), side_keys.end(), move_key(nodes[j].move)))
+                        {
+                            Selection::on_amaf(nodes[resolve(j)].stats, child_t);
+                        }
+                    }
+                }
+            }
+
+            // Get the move of the root child with the highest score
+            chess::move best_move() const
+            {
+                const Node& root_node = nodes[root];
+                index_type best = root_node.first_child;
+                for (index_type i = root_node.first_child; i < root_node.first_child + root_node.n_children; ++i)
+                {
+                    if (nodes[resolve(i)].t.load(std::memory_order_relaxed) > nodes[resolve(best)].t.load(std::memory_order_relaxed)) best = i;
+                }
+                return nodes[best].move;
+            }
+
+            // Moves of the path from the root, at most max_length of them
+            // Starts with best_move(), then follows the most visited children
+            std::vector<chess::move> principal_variation(size_t max_length = 32) const
+            {
+                std::vector<chess::move> moves{};
+                if (nodes.size() == 0) return moves;
+                index_type current = root;
+                while (moves.size() < max_length && nodes[current].has_children())
+                {
+                    const Node& current_node = nodes[current];
+                    index_type best = current_node.first_child;
+                    for (index_type i = current_node.first_child; i < current_node.first_child + current_node.n_children; ++i)
+                    {
+                        const Node& child = nodes[resolve(i)];
+                        const Node& best_child = nodes[resolve(best)];
+                        bool better = current == root
+                            ? child.t.load(std::memory_order_relaxed) > best_child.t.load(std::memory_order_relaxed)
+                            : child.n.load(std::memory_order_relaxed) > best_child.n.load(std::memory_order_relaxed);
+                        if (better) best = i;
+                    }
+                    if (nodes[resolve(best)].n.load(std::memory_order_relaxed) == 0) break;
+                    moves.push_back(nodes[best].move);
+                    current = resolve(best);
+                }
+                return moves;
+            }
+
+            // Add n visits with summed score t, from the side to move at the root, to root child idx and to the root
+            // Lets a search start from statistics kept outside the tree
+            void add_root_visits(index_type idx, int n, double t)
+            {
+                Node& child = nodes[resolve(idx)];
+                child.t.fetch_add(t, std::memory_order_relaxed);
+                child.n.fetch_add(n, std::memory_order_relaxed);
+                nodes[root].t.fetch_add(-t, std::memory_order_relaxed);
+                nodes[root].n.fetch_add(n, std::memory_order_relaxed);
+            }
+
+            // Get how far the best root child is ahead of the second best by score
+            double leader_gap() const
+            {
+                const Node& root_node = nodes[root];
+                double best = -DBL_MAX, second = -DBL_MAX;
+                for (index_type i = root_node.first_child; i < root_node.first_child + root_node.n_children; ++i)
+                {
+                    double t = nodes[resolve(i)].t.load(std::memory_order_relaxed);
+                    if (t > best)
+                    {
+                        second = best;
+                        best = t;
+                    }
+                    else if (t > second)
+                    {
+                        second = t;
+                    }
+                }
+                return root_node.n_children > 1 ? best - second : DBL_MAX;
+            }
+
+            // Check if the leaf of cursor is known to be a terminal state
+            bool is_over(const Cursor& cursor) const
+            {
+                return nodes[resolve(cursor.path.back())].is_terminal_node.load(std::memory_order_relaxed);
+            }
+
+            inline Node& operator[](index_type idx)
+            {
+                return nodes[idx];
+            }
+
+            inline const Node& operator[](index_type idx) const
+            {
+                return nodes[idx];
+            }
+
+            // Amount of nodes in the tree
+            size_t size() const
+            {
+                return nodes.size();
+            }
+
+            // Amount of nodes with a cached position
+            size_t cached_states() const
+            {
+                return states.size();
+            }
+
+            // Bytes used by nodes and cached positions
+            size_t bytes() const
+            {
+                return nodes.size() * sizeof(Node) + states.size() * sizeof(chess::position);
+            }
+
+            // Per node byte counts of the current tree
+            std::string memory_report() const
+            {
+                std::string report = "-- Memory Report --";
+                report += "\nnodes: " + std::to_string(size());
+                report += "\ncached states: " + std::to_string(cached_states());
+                report += "\nbytes per node: " + std::to_string(sizeof(Node));
+                report += "\nbytes per cached state: " + std::to_string(sizeof(chess::position));
+                report += "\naverage bytes per node: " + std::to_string(size() ? bytes() / double(size()) : 0.0);
+                report += "\nreserved bytes: " + std::to_string(nodes.reserved_bytes() + states.reserved_bytes());
+                return report;
+            }
+
+            static constexpr index_type root = 0;
+            static constexpr int DEFAULT_CACHE_VISITS = 64;
+
+            // Apply virtual losses on selected paths, only needed when workers share the tree
+            bool virtual_loss = false;
+
+            // Transposition table, disabled unless the tree was given a table_size
+            transposition::Table table;
+            // Zobrist key of the root while the table is enabled
+            std::optional<transposition::Key> root_key{};
+
+        private:
+            static inline double WIN_SCORE()
+            {
+                return node::Node::WIN_SCORE;
+            }
+
+            static inline double DRAW_SCORE()
+            {
+                return node::Node::DRAW_SCORE;
+            }
+
+            // Add score t and a visit to current_node
+            inline void add_visit(Node& current_node, double t)
+            {
+                current_node.t.fetch_add(t, std::memory_order_relaxed);
+                current_node.n.fetch_add(1, std::memory_order_relaxed);
+                Selection::on_visit(current_node.stats, t);
+            }
+
+            // Score the leaf of cursor and mark it terminal if its position is mate or stalemate
+            // Only the worker that marks it backs the score up, the others drop their virtual losses
+            // Returns false if the leaf is not terminal
+            bool score_terminal(Cursor& cursor)
+            {
+                double t;
+                if (cursor.state.is_checkmate()) t = cursor.state.get_turn() == player_side ? -WIN_SCORE() : WIN_SCORE();
+                else if (cursor.state.is_stalemate()) t = DRAW_SCORE();
+                else return false;
+                bool expected = false;
+                if (nodes[resolve(cursor.path.back())].is_terminal_node.compare_exchange_strong(expected, true, std::memory_order_relaxed))
+                {
+                    update(cursor, t);
+                }
+                else
+                {
+                    revert_virtual_loss(cursor);
+                }
+                return true;
+            }
+
+            // Key of move used to match AMAF moves, its bytes when they fit in 64 bits without padding
+            // Wider move types fall back to an FNV-1a hash of the long algebraic notation
+            static std::uint64_t move_key(const chess::move& move)
+            {
+                if constexpr (sizeof(chess::move) <= sizeof(std::uint64_t) && std::has_unique_object_representations_v<chess::move>)
+                {
+                    std::uint64_t key = 0;
+                    std::memcpy(&key, &move, sizeof(chess::move));
+                    return key;
+                }
+                else
+                {
+                    std::uint64_t key = 0xCBF29CE484222325ull;
+                    for (char c : move.to_lan())
+                    {
+                        key = (key ^ static_cast<unsigned char>(c)) * 0x100000001B3ull;
+                    }
+                    return key;
+                }
+            }
+
+            // Copy statistics and cached position of slot from into spare_nodes[to]
+            // A linked slot is copied as an unexpanded leaf with the statistics of its node
+            void copy_node(index_type from, index_type to)
+            {
+                const Node& source = nodes[resolve(from)];
+                Node& target = spare_nodes[to];
+                target.move = nodes[from].move;
+                if (nodes[from].link == null_index)
+                {
+                    target.n_children = source.n_children;
+                    target.expand_state.store(source.expand_state.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                }
+                target.is_terminal_node.store(source.is_terminal_node.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                target.t.store(source.t.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                target.n.store(source.n.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                Selection::copy(target.stats, source.stats);
+                index_type state_idx = source.state_idx.load(std::memory_order_relaxed);
+                if (state_idx != null_index)
+                {
+                    target.state_idx.store(spare_states.allocate(1, states[state_idx]), std::memory_order_relaxed);
+                }
+            }
+
+            // Store state as the cached position of current_node unless another worker already did
+            void cache_state(Node& current_node, const chess::position& state)
+            {
+                std::lock_guard<std::mutex> lock{allocation_mutex};
+                if (current_node.state_idx.load(std::memory_order_relaxed) != null_index) return;
+                current_node.state_idx.store(states.allocate(1, state), std::memory_order_release);
+            }
+
+            // Copy the deepest cached position on the path and replay the moves below it
+            // Moves come from the walked slots, a shared node may have been reached by other moves
+            // Nodes on the way that are visited often enough get their position cached
+            void rebuild_state(Cursor& cursor)
+            {
+                std::vector<index_type>& path = cursor.path;
+                size_t anchor = path.size() - 1;
+                index_type state_idx;
+                while ((state_idx = nodes[resolve(path[anchor])].state_idx.load(std::memory_order_acquire)) == null_index) --anchor;
+                cursor.state = states[state_idx];
+                for (size_t i = anchor + 1; i < path.size(); ++i)
+                {
+                    cursor.state.make_move(nodes[path[i]].move);
+                    Node& current_node = nodes[resolve(path[i])];
+                    if (current_node.n.load(std::memory_order_relaxed) >= cache_visits)
+                    {
+                        cache_state(current_node, cursor.state);
+                    }
+                }
+            }
+
+            chess::side player_side;
+            chess::side root_turn{player_side};
+            int cache_visits;
+            Pool<Node> nodes{};
+            Pool<chess::position> states{};
+            Pool<Node> spare_nodes{};
+            Pool<chess::position> spare_states{};
+            std::mutex allocation_mutex{};
+    };
+
+    using Tree = BasicTree<selection::UCB1>;
+    using Node = Tree::Node;
+}
+
+#endif /* ARENA_H */
\ No newline at end of file
@@ -0,0 +1,142 @@
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <algorithm>
+
+// Search limits by iterations, wall clock time and allocated nodes
+namespace budget
+{
+    // How much of its limits a search used
+    struct Usage
+    {
+        int iterations{0};
+        double milliseconds{0};
+        size_t nodes{0};
+        bool stopped_early{false};
+        // Bytes of the tree when the search ended, 0 for models that do not count them
+        size_t bytes{0};
+        // Whether the search ended on a proven root, only set by models with a solver
+        bool proven{false};
+
+        std::string to_string() const
+        {
+            std::string report = "-- Budget Report --";
+            report += "\niterations: " + std::to_string(iterations);
+            report += "\nmilliseconds: " + std::to_string(milliseconds);
+            report += "\nnodes: " + std::to_string(nodes);
+            report += "\nbytes: " + std::to_string(bytes);
+            report += "\nstopped early: " + std::to_string(stopped_early);
+            report += "\nproven: " + std::to_string(proven);
+            return report;
+        }
+    };
+
+    // Limits of a single search, a limit of 0 is not enforced
+    // early_stop ends the search once the best root child cannot be overtaken in the remaining budget
+    // stop is polled on every iteration, setting it from another thread ends the search
+    // info is called by a searching thread about every info_ms milliseconds, e.g. to print progress
+    struct Limits
+    {
+        int iterations{0};
+        int milliseconds{0};
+        size_t nodes{0};
+        bool early_stop{false};
+        const std::atomic<bool>* stop{nullptr};
+        int info_ms{0};
+        std::function<void(const Usage&)> info{};
+    };
+
+    // Tracks a search against its limits, safe to share between workers
+    // The clock, node count and early stopping are only checked every CHECK_INTERVAL iterations
+    class Budget
+    {
+        public:
+            static constexpr int CHECK_INTERVAL = 16;
+
+            // max_score is the largest change of a root child score in one iteration
+            Budget(const Limits& limits, double max_score = 1.0)
+                : limits{limits},
+                max_score{max_score},
+                next_info_ms{limits.info_ms}
+            {}
+
+            // Claim the next iteration, returns false once a limit is reached
+            // nodes and leader_gap are only called when the periodic check is due
+            // leader_gap returns how far the best root child is ahead of the second best
+            template<typename NodeCount, typename LeaderGap>
+            bool next(NodeCount nodes, LeaderGap leader_gap)
+            {
+                if (exhausted.load(std::memory_order_relaxed)) return false;
+                if (limits.stop && limits.stop->load(std::memory_order_relaxed))
+                {
+                    exhausted.store(true, std::memory_order_relaxed);
+                    return false;
+                }
+                int iteration = started.fetch_add(1, std::memory_order_relaxed);
+                if (limits.iterations && iteration >= limits.iterations) return stop(false);
+                if (iteration % CHECK_INTERVAL != 0) return true;
+                if (limits.info) report(nodes);
+                if ((limits.milliseconds && elapsed_ms() >= limits.milliseconds) || (limits.nodes && nodes() >= limits.nodes)) return stop(false);
+                if (limits.early_stop && iteration > 0 && leader_gap() > remaining(iteration) * max_score) return stop(true);
+                return true;
+            }
+
+            // Estimated iterations left before a time or iteration limit is reached
+            double remaining(int iteration) const
+            {
+                double left = limits.iterations ? limits.iterations - iteration : 1e300;
+                if (limits.milliseconds)
+                {
+                    double elapsed = std::max(elapsed_ms(), 1e-3);
+                    left = std::min(left, (limits.milliseconds - elapsed) * iteration / elapsed);
+                }
+                return std::max(left, 0.0);
+            }
+
+            double elapsed_ms() const
+            {
+                return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_t).count();
+            }
+
+            // Used part of the limits, nodes and bytes are the size of the tree when the search ended
+            Usage usage(size_t nodes, size_t bytes = 0) const
+            {
+                return Usage{started.load(std::memory_order_relaxed), elapsed_ms(), nodes, stopped_early.load(std::memory_order_relaxed), bytes};
+            }
+
+        private:
+            // Call limits.info if it is due, only one of the workers sharing the budget gets the call
+            template<typename NodeCount>
+            void report(NodeCount nodes)
+            {
+                long now = static_cast<long>(elapsed_ms());
+                long due = next_info_ms.load(std::memory_order_relaxed);
+                if (now < due || !next_info_ms.compare_exchange_strong(due, now + std::max(limits.info_ms, 1), std::memory_order_relaxed)) return;
+                limits.info(usage(nodes()));
+            }
+
+            // Give back the iteration that could not be run and end the search
+            bool stop(bool early)
+            {
+                started.fetch_sub(1, std::memory_order_relaxed);
+                if (early) stopped_early.store(true, std::memory_order_relaxed);
+                exhausted.store(true, std::memory_order_relaxed);
+                return false;
+            }
+
+            Limits limits;
+            double max_score;
+            std::chrono::steady_clock::time_point start_t = std::chrono::steady_clock::now();
+            std::atomic<int> started{0};
+            std::atomic<bool> exhausted{false};
+            std::atomic<bool> stopped_early{false};
+            std::atomic<long> next_info_ms;
+    };
+}
+
+#endif /* BUDGET_H */
\ No newline at end of file
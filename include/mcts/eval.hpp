@@ -0,0 +1,255 @@
+#ifndef EVAL_H
+#define EVAL_H
+
+#include <chess/chess.hpp>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+// Cheap static evaluation for heuristic rollouts
+// Keeps its own mailbox board, read once from the board diagram and updated move by move
+// A diagram or move notation that cannot be read throws std::invalid_argument instead of skewing rollouts
+namespace eval
+{
+    // Piece codes of the mailbox, white pieces are positive and black pieces negative
+    enum : std::int8_t { empty = 0, pawn = 1, knight = 2, bishop = 3, rook = 4, queen = 5, king = 6 };
+
+    constexpr std::array<int, 7> PIECE_VALUES{0, 100, 320, 330, 500, 900, 20000};
+
+    // Piece-square tables from white's side, written with rank 8 on top
+    constexpr std::array<std::array<int, 64>, 7> PIECE_SQUARE{{
+        {},
+        {
+             0,  0,  0,  0,  0,  0,  0,  0,
+            50, 50, 50, 50, 50, 50, 50, 50,
+            10, 10, 20, 30, 30, 20, 10, 10,
+             5,  5, 10, 25, 25, 10,  5,  5,
+             0,  0,  0, 20, 20,  0,  0,  0,
+             5, -5,-10,  0,  0,-10, -5,  5,
+             5, 10, 10,-20,-20, 10, 10,  5,
+             0,  0,  0,  0,  0,  0,  0,  0
+        },
+        {
+            -50,-40,-30,-30,-30,-30,-40,-50,
+            -40,-20,  0,  0,  0,  0,-20,-40,
+            -30,  0, 10, 15, 15, 10,  0,-30,
+            -30,  5, 15, 20, 20, 15,  5,-30,
+            -30,  0, 15, 20, 20, 15,  0,-30,
+            -30,  5, 10, 15, 15, 10,  5,-30,
+            -40,-20,  0,  5,  5,  0,-20,-40,
+            -50,-40,-30,-30,-30,-30,-40,-50
+        },
+        {
+            -20,-10,-10,-10,-10,-10,-10,-20,
+            -10,  0,  0,  0,  0,  0,  0,-10,
+            -10,  0,  5, 10, 10,  5,  0,-10,
+            -10,  5,  5, 10, 10,  5,  5,-10,
+            -10,  0, 10, 10, 10, 10,  0,-10,
+            -10, 10, 10, 10, 10, 10, 10,-10,
+            -10,  5,  0,  0,  0,  0,  5,-10,
+            -20,-10,-10,-10,-10,-10,-10,-20
+        },
+        {
+             0,  0,  0,  0,  0,  0,  0,  0,
+             5, 10, 10, 10, 10, 10, 10,  5,
+            -5,  0,  0,  0,  0,  0,  0, -5,
+            -5,  0,  0,  0,  0,  0,  0, -5,
+            -5,  0,  0,  0,  0,  0,  0, -5,
+            -5,  0,  0,  0,  0,  0,  0, -5,
+            -5,  0,  0,  0,  0,  0,  0, -5,
+             0,  0,  0,  5,  5,  0,  0,  0
+        },
+        {
+            -20,-10,-10, -5, -5,-10,-10,-20,
+            -10,  0,  0,  0,  0,  0,  0,-10,
+            -10,  0,  5,  5,  5,  5,  0,-10,
+             -5,  0,  5,  5,  5,  5,  0, -5,
+              0,  0,  5,  5,  5,  5,  0, -5,
+            -10,  5,  5,  5,  5,  5,  0,-10,
+            -10,  0,  5,  0,  0,  0,  0,-10,
+            -20,-10,-10, -5, -5,-10,-10,-20
+        },
+        {
+            -30,-40,-40,-50,-50,-40,-40,-30,
+            -30,-40,-40,-50,-50,-40,-40,-30,
+            -30,-40,-40,-50,-50,-40,-40,-30,
+            -30,-40,-40,-50,-50,-40,-40,-30,
+            -20,-30,-30,-40,-40,-30,-30,-20,
+            -10,-20,-20,-20,-20,-20,-20,-10,
+             20, 20,  0,  0,  0,  0, 20, 20,
+             20, 30, 10,  0,  0, 10, 30, 20
+        }
+    }};
+
+    // Material and piece-square value of piece on square in centipawns, positive for white
+    // Squares count from a1 = 0 to h8 = 63
+    inline int square_value(std::int8_t piece, int square)
+    {
+        if (piece == empty) return 0;
+        int type = std::abs(piece);
+        int rank = square / 8, file = square % 8;
+        int row = piece > 0 ? 7 - rank : rank;
+        int value = PIECE_VALUES[type] + PIECE_SQUARE[type][row * 8 + file];
+        return piece > 0 ? value : -value;
+    }
+
+    // Origin, destination and promotion of a move, read from its long algebraic notation
+    struct Move
+    {
+        int from = 0;
+        int to = 0;
+        std::int8_t promotion = empty;
+    };
+
+    inline std::int8_t piece_code(char c)
+    {
+        switch (c)
+        {
+            case 'P': return pawn;
+            case 'N': return knight;
+            case 'B': return bishop;
+            case 'R': return rook;
+            case 'Q': return queen;
+            case 'K': return king;
+            case 'p': return -pawn;
+            case 'n': return -knight;
+            case 'b': return -bishop;
+            case 'r': return -rook;
+            case 'q': return -queen;
+            case 'k': return -king;
+            default: return empty;
+        }
+    }
+
+    inline Move parse_lan(const std::string& lan)
+    {
+        if (lan.size() < 4 || lan[0] < 'a' || lan[0] > 'h' || lan[1] < '1' || lan[1] > '8' || lan[2] < 'a' || lan[2] > 'h' || lan[3] < '1' || lan[3] > '8')
+        {
+            throw std::invalid_argument{"eval::parse cannot read move " + lan};
+        }
+        Move parsed{};
+        parsed.from = (lan[1] - '1') * 8 + (lan[0] - 'a');
+        parsed.to = (lan[3] - '1') * 8 + (lan[2] - 'a');
+        if (lan.size() > 4) parsed.promotion = static_cast<std::int8_t>(std::abs(piece_code(lan[4])));
+        return parsed;
+    }
+
+    // Decode move, keeping the last decoded moves per thread keyed by the bytes of the move
+    // The notation of a move does not depend on the position, and the same moves come up ply after ply,
+    // so only moves missing from the cache are turned into a string
+    inline Move parse(const chess::move& move)
+    {
+        if constexpr (sizeof(chess::move) <= sizeof(std::uint64_t) && std::has_unique_object_representations_v<chess::move>)
+        {
+            struct Slot
+            {
+                std::uint64_t key = 0;
+                bool used = false;
+                Move parsed{};
+            };
+            thread_local std::array<Slot, 1024> cache{};
+            std::uint64_t key = 0;
+            std::memcpy(&key, &move, sizeof(chess::move));
+            Slot& slot = cache[(key * 0x9E3779B97F4A7C15ull) >> 54];
+            if (!slot.used || slot.key != key) slot = Slot{key, true, parse_lan(move.to_lan())};
+            return slot.parsed;
+        }
+        else
+        {
+            return parse_lan(move.to_lan());
+        }
+    }
+
+    // Mailbox board with its material and piece-square score kept up to date move by move
+    // Read from the board diagram of a position, one character per square from a8 to h1
+    // with piece letters for pieces and any other visible character for an empty square
+    // A diagram that does not read as 64 squares with one king per side throws std::invalid_argument
+    struct Board
+    {
+        explicit Board(const chess::position& state)
+        {
+            std::string diagram = state.pieces().to_string();
+            int square = 0, white_kings = 0, black_kings = 0;
+            for (char c : diagram)
+            {
+                if (c == ' ' || c == '\n' || c == '\r' || c == '\t') continue;
+                if (square >= 64) break;
+                std::int8_t piece = piece_code(c);
+                int board_square = (7 - square / 8) * 8 + square % 8;
+                squares[board_square] = piece;
+                score += square_value(piece, board_square);
+                white_kings += piece == king;
+                black_kings += piece == -king;
+                ++square;
+            }
+            if (square != 64 || white_kings != 1 || black_kings != 1)
+            {
+                throw std::invalid_argument{"eval::Board cannot read the board diagram " + diagram};
+            }
+        }
+
+        // Piece moved by move
+        inline std::int8_t mover(const Move& move) const
+        {
+            return squares[move.from];
+        }
+
+        // Piece captured by move, counting en passant
+        inline std::int8_t victim(const Move& move) const
+        {
+            std::int8_t piece = squares[move.to];
+            if (piece == empty && std::abs(squares[move.from]) == pawn && move.from % 8 != move.to % 8)
+            {
+                return squares[(move.from / 8) * 8 + move.to % 8];
+            }
+            return piece;
+        }
+
+        // Play move on the board, castling moves the rook and en passant removes the passed pawn
+        void play(const Move& move)
+        {
+            std::int8_t piece = squares[move.from];
+            if (std::abs(piece) == pawn && move.from % 8 != move.to % 8 && squares[move.to] == empty)
+            {
+                set((move.from / 8) * 8 + move.to % 8, empty);
+            }
+            if (std::abs(piece) == king && std::abs(move.from % 8 - move.to % 8) == 2)
+            {
+                int rank = move.from / 8 * 8;
+                bool king_side = move.to % 8 == 6;
+                int rook_from = rank + (king_side ? 7 : 0);
+                int rook_to = rank + (king_side ? 5 : 3);
+                set(rook_to, squares[rook_from]);
+                set(rook_from, empty);
+            }
+            std::int8_t placed = move.promotion != empty ? static_cast<std::int8_t>(piece > 0 ? move.promotion : -move.promotion) : piece;
+            set(move.from, empty);
+            set(move.to, placed);
+        }
+
+        std::array<std::int8_t, 64> squares{};
+        int score = 0;
+
+        private:
+            inline void set(int square, std::int8_t piece)
+            {
+                score += square_value(piece, square) - square_value(squares[square], square);
+                squares[square] = piece;
+            }
+    };
+
+    // Map a centipawn score for white to a rollout score for player_side in [-win_score, win_score]
+    // scale is the score in centipawns that counts as roughly three quarters of a win
+    inline double to_rollout_score(int score, chess::side player_side, double win_score, double scale)
+    {
+        double white_score = std::tanh(score / scale);
+        return win_score * (player_side == chess::side::side_white ? white_score : -white_score);
+    }
+}
+
+#endif /* EVAL_H */
\ No newline at end of file
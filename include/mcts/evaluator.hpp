@@ -0,0 +1,192 @@
+#ifndef EVALUATOR_H
+#define EVALUATOR_H
+
+#include <chess/chess.hpp>
+#include <mcts/node.hpp>
+#include <mcts/rng.hpp>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Asynchronous leaf evaluation, the search submits leaves and goes on selecting while they are scored
+namespace evaluator
+{
+    // Score of the leaf submitted with ticket, for the side the evaluator scores for
+    struct Result
+    {
+        std::uint64_t ticket;
+        double score;
+    };
+
+    // Leaf evaluator the search hands positions to without waiting for their scores
+    // Tickets are chosen by the submitter and come back with the results, in any order
+    class Evaluator
+    {
+        public:
+            virtual ~Evaluator() = default;
+
+            // Queue state for evaluation
+            virtual void submit(std::uint64_t ticket, const chess::position& state) = 0;
+
+            // Evaluate the requests queued so far even if they do not fill a batch
+            virtual void flush() = 0;
+
+            // Append finished results to results and return how many there were
+            // With wait set, blocks until there is at least one if some request is outstanding
+            // Waiting on requests that do not fill a batch needs a flush first
+            virtual size_t collect(std::vector<Result>& results, bool wait) = 0;
+    };
+
+    // In-process reference evaluator, n_workers threads take batches of up to batch_size queued leaves
+    // and score them for player_side with a batch policy such as policy::rollout::BatchRollout
+    // A batch starts once it is full or flush was called after its requests were submitted
+    // latency_us is added to every batch, like the round trip of an evaluation server or the launch of a network
+    class BatchEvaluator : public Evaluator
+    {
+        public:
+            BatchEvaluator(node::batch_policy_function_type policy, chess::side player_side, size_t batch_size, int n_workers = 1, int latency_us = 0, std::uint64_t seed = 0)
+                : player_side{player_side},
+                batch_size{std::max<size_t>(batch_size, 1)},
+                latency_us{latency_us}
+            {
+                for (int i = 0; i < std::max(n_workers, 1); ++i)
+                {
+                    workers.emplace_back([this, policy, seed, i]() { work(policy, rng::stream_seed(seed, i)); });
+                }
+            }
+            BatchEvaluator(const BatchEvaluator&) = delete;
+            BatchEvaluator& operator=(const BatchEvaluator&) = delete;
+
+            ~BatchEvaluator() override
+            {
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    stopping = true;
+                }
+                queued_cv.notify_all();
+                for (std::thread& worker : workers) worker.join();
+            }
+
+            void submit(std::uint64_t ticket, const chess::position& state) override
+            {
+                bool full{false};
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    queue.push_back(Request{ticket, state});
+                    ++submitted;
+                    ++outstanding;
+                    full = queue.size() >= batch_size;
+                }
+                if (full) queued_cv.notify_one();
+            }
+
+            void flush() override
+            {
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    flush_mark = submitted;
+                }
+                queued_cv.notify_all();
+            }
+
+            size_t collect(std::vector<Result>& results, bool wait) override
+            {
+                std::unique_lock<std::mutex> lock{mutex};
+                if (wait) done_cv.wait(lock, [this]() { return !done.empty() || outstanding == 0; });
+                size_t count = done.size();
+                results.insert(results.end(), done.begin(), done.end());
+                done.clear();
+                outstanding -= count;
+                return count;
+            }
+
+            // Batches evaluated so far and the leaves in them
+            std::uint64_t batches() const
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+                return n_batches;
+            }
+
+            std::uint64_t evaluated() const
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+                return n_evaluated;
+            }
+
+        private:
+            struct Request
+            {
+                std::uint64_t ticket;
+                chess::position state;
+            };
+
+            // Whether a worker may take a batch now, the caller holds mutex
+            bool batch_ready() const
+            {
+                return queue.size() >= batch_size || (!queue.empty() && taken < flush_mark);
+            }
+
+            // Take batches until the evaluator is destroyed, every worker scores with its own copy of policy
+            void work(node::batch_policy_function_type policy, std::uint64_t seed)
+            {
+                node::Playout playout{};
+                playout.generator.seed(seed);
+                std::vector<std::uint64_t> tickets{};
+                std::vector<chess::position> states{};
+                std::vector<double> scores{};
+                while (true)
+                {
+                    {
+                        std::unique_lock<std::mutex> lock{mutex};
+                        queued_cv.wait(lock, [this]() { return stopping || batch_ready(); });
+                        if (stopping) return;
+                        size_t count = std::min(batch_size, queue.size());
+                        tickets.clear();
+                        states.clear();
+                        for (size_t i = 0; i < count; ++i)
+                        {
+                            tickets.push_back(queue.front().ticket);
+                            states.push_back(queue.front().state);
+                            queue.pop_front();
+                        }
+                        taken += count;
+                        // Another worker may take the rest of a flushed queue or a further full batch
+                        if (batch_ready()) queued_cv.notify_one();
+                    }
+                    policy(states, player_side, playout, scores);
+                    if (latency_us > 0) std::this_thread::sleep_for(std::chrono::microseconds(latency_us));
+                    {
+                        std::lock_guard<std::mutex> lock{mutex};
+                        for (size_t i = 0; i < tickets.size(); ++i) done.push_back(Result{tickets[i], scores[i]});
+                        ++n_batches;
+                        n_evaluated += tickets.size();
+                    }
+                    done_cv.notify_all();
+                }
+            }
+
+            chess::side player_side;
+            size_t batch_size;
+            int latency_us;
+            mutable std::mutex mutex{};
+            std::condition_variable queued_cv{};
+            std::condition_variable done_cv{};
+            std::deque<Request> queue{};
+            std::vector<Result> done{};
+            std::uint64_t submitted{0};
+            std::uint64_t taken{0};
+            std::uint64_t flush_mark{0};
+            std::uint64_t outstanding{0};
+            std::uint64_t n_batches{0};
+            std::uint64_t n_evaluated{0};
+            bool stopping{false};
+            std::vector<std::thread> workers{};
+    };
+}
+
+#endif /* EVALUATOR_H */
\ No newline at end of file
@@ -0,0 +1,272 @@
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Build with -DMCTS_INSTRUMENT=0 to compile every timer and counter out
+#ifndef MCTS_INSTRUMENT
+#define MCTS_INSTRUMENT 1
+#endif
+
+// Low overhead counters and phase timers of one search, exported as JSON
+// Only every SAMPLE_PERIOD-th iteration is timed, with the time stamp counter where there is one
+namespace instrument
+{
+    constexpr bool ENABLED = MCTS_INSTRUMENT != 0;
+    constexpr std::uint32_t SAMPLE_PERIOD = 16;
+
+    // Heap allocations, counted by the program that defines MCTS_COUNT_ALLOCATIONS
+    inline std::atomic<long> allocations{0};
+
+    // Time stamp counter, steady clock nanoseconds where there is none
+    inline std::uint64_t ticks()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    enum phase { select_phase, expand_phase, rollout_phase, backprop_phase, phase_count };
+    constexpr std::array<const char*, phase_count> PHASE_NAMES{"select", "expand", "rollout", "backprop"};
+
+    // Power of two histogram of tick counts, bucket b holds counts in [2^(b-1), 2^b)
+    struct Histogram
+    {
+        inline void add(std::uint64_t value)
+        {
+            ++buckets[value ? 64 - __builtin_clzll(value) : 0];
+            ++count;
+            total += value;
+        }
+
+        void merge(const Histogram& other)
+        {
+            for (size_t b = 0; b < buckets.size(); ++b) buckets[b] += other.buckets[b];
+            count += other.count;
+            total += other.total;
+        }
+
+        // Upper bound of the bucket holding quantile q of the counts
+        std::uint64_t quantile(double q) const
+        {
+            std::uint64_t seen = 0;
+            for (size_t b = 0; b < buckets.size(); ++b)
+            {
+                seen += buckets[b];
+                if (count && seen >= q * count) return b == 0 ? 0 : (b >= 64 ? ~0ull : (1ull << b) - 1);
+            }
+            return 0;
+        }
+
+        std::array<std::uint64_t, 65> buckets{};
+        std::uint64_t count{0};
+        std::uint64_t total{0};
+    };
+
+    // Counters and sampled phase latencies of one search
+    // Phase times of sampled iterations are scaled by SAMPLE_PERIOD to estimate the totals
+    struct SearchStats
+    {
+        // Reset the statistics and start the clocks
+        void start()
+        {
+            *this = SearchStats{};
+            if constexpr (ENABLED)
+            {
+                start_ticks = ticks();
+                start_time = std::chrono::steady_clock::now();
+                start_allocations = allocations.load(std::memory_order_relaxed);
+            }
+        }
+
+        // Stop the clocks, the tick rate is measured over the search
+        void finish()
+        {
+            if constexpr (ENABLED)
+            {
+                seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+                std::uint64_t elapsed_ticks = ticks() - start_ticks;
+                ticks_per_second = seconds > 0 ? elapsed_ticks / seconds : 0;
+                heap_allocations = allocations.load(std::memory_order_relaxed) - start_allocations;
+            }
+        }
+
+        // Start an iteration, true if its phases are to be timed
+        inline bool next_iteration()
+        {
+            if constexpr (ENABLED) return iterations++ % SAMPLE_PERIOD == 0;
+            return false;
+        }
+
+        // Start a batch of rollouts, true if it is to be timed
+        inline bool next_batch()
+        {
+            if constexpr (ENABLED) return batches++ % SAMPLE_PERIOD == 0;
+            return false;
+        }
+
+        inline void add_nodes(size_t count)
+        {
+            if constexpr (ENABLED) nodes_expanded += count;
+        }
+
+        // Count rollouts that played plies moves between them
+        inline void add_rollouts(std::uint64_t count, std::uint64_t plies)
+        {
+            if constexpr (ENABLED)
+            {
+                rollouts += count;
+                rollout_plies += plies;
+            }
+        }
+
+        inline void add_depth(size_t depth)
+        {
+            if constexpr (ENABLED)
+            {
+                ++depth_samples;
+                depth_sum += depth;
+                if (depth > max_depth) max_depth = depth;
+            }
+        }
+
+        // Add other, e.g. to keep totals over several searches
+        void merge(const SearchStats& other)
+        {
+            iterations += other.iterations;
+            batches += other.batches;
+            nodes_expanded += other.nodes_expanded;
+            rollouts += other.rollouts;
+            rollout_plies += other.rollout_plies;
+            depth_samples += other.depth_samples;
+            depth_sum += other.depth_sum;
+            if (other.max_depth > max_depth) max_depth = other.max_depth;
+            heap_allocations += other.heap_allocations;
+            double total_ticks = seconds * ticks_per_second + other.seconds * other.ticks_per_second;
+            seconds += other.seconds;
+            ticks_per_second = seconds > 0 ? total_ticks / seconds : 0;
+            for (size_t p = 0; p < phase_count; ++p) phases[p].merge(other.phases[p]);
+        }
+
+        // Estimated seconds spent in phase p
+        double phase_seconds(phase p) const
+        {
+            return ticks_per_second > 0 ? phases[p].total * double(SAMPLE_PERIOD) / ticks_per_second : 0;
+        }
+
+        // One line JSON object with the counters and per phase latency in nanoseconds
+        std::string to_json() const
+        {
+            auto ns = [this](double phase_ticks) { return std::to_string(ticks_per_second > 0 ? phase_ticks * 1e9 / ticks_per_second : 0.0); };
+            std::string json = "{\"seconds\":" + std::to_string(seconds);
+            json += ",\"iterations\":" + std::to_string(iterations);
+            json += ",\"nodes_expanded\":" + std::to_string(nodes_expanded);
+            json += ",\"rollouts\":" + std::to_string(rollouts);
+            json += ",\"rollout_plies\":" + std::to_string(rollout_plies);
+            json += ",\"average_rollout_plies\":" + std::to_string(rollouts ? rollout_plies / double(rollouts) : 0.0);
+            json += ",\"average_depth\":" + std::to_string(depth_samples ? depth_sum / double(depth_samples) : 0.0);
+            json += ",\"max_depth\":" + std::to_string(max_depth);
+            json += ",\"allocations\":" + std::to_string(heap_allocations);
+            json += ",\"sample_period\":" + std::to_string(SAMPLE_PERIOD);
+            json += ",\"phases\":{";
+            for (size_t p = 0; p < phase_count; ++p)
+            {
+                const Histogram& histogram = phases[p];
+                if (p) json += ',';
+                json += '"' + std::string{PHASE_NAMES[p]} + "\":{\"samples\":" + std::to_string(histogram.count);
+                json += ",\"mean_ns\":" + ns(histogram.count ? histogram.total / double(histogram.count) : 0.0);
+                json += ",\"p50_ns\":" + ns(histogram.quantile(0.5));
+                json += ",\"p99_ns\":" + ns(histogram.quantile(0.99));
+                json += ",\"total_seconds\":" + std::to_string(phase_seconds(static_cast<phase>(p))) + '}';
+            }
+            json += "}}";
+            return json;
+        }
+
+        std::uint64_t iterations{0};
+        std::uint64_t batches{0};
+        std::uint64_t nodes_expanded{0};
+        std::uint64_t rollouts{0};
+        std::uint64_t rollout_plies{0};
+        std::uint64_t depth_samples{0};
+        std::uint64_t depth_sum{0};
+        std::uint64_t max_depth{0};
+        long heap_allocations{0};
+        double seconds{0};
+        double ticks_per_second{0};
+        std::array<Histogram, phase_count> phases{};
+
+        private:
+            std::uint64_t start_ticks{0};
+            std::chrono::steady_clock::time_point start_time{};
+            long start_allocations{0};
+    };
+
+    // Adds the ticks spent in its scope to a phase histogram, if the iteration is sampled
+    class ScopedTimer
+    {
+        public:
+            inline ScopedTimer(SearchStats& stats, phase p, bool sampled)
+                : ScopedTimer{&stats, p, sampled}
+            {}
+
+            // Times nothing when stats is null
+            inline ScopedTimer(SearchStats* stats, phase p, bool sampled)
+                : histogram{sampled && stats ? &stats->phases[p] : nullptr}
+            {
+                if constexpr (ENABLED)
+                {
+                    if (histogram) start = ticks();
+                }
+            }
+
+            inline ~ScopedTimer()
+            {
+                if constexpr (ENABLED)
+                {
+                    if (histogram) histogram->add(ticks() - start);
+                }
+            }
+
+            ScopedTimer(const ScopedTimer&) = delete;
+            ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+        private:
+            Histogram* histogram;
+            std::uint64_t start{0};
+    };
+}
+
+// Define MCTS_COUNT_ALLOCATIONS in the one translation unit of a program that should count heap allocations
+#ifdef MCTS_COUNT_ALLOCATIONS
+void* operator new(std::size_t size)
+{
+    instrument::allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1)) return ptr;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+#endif
+
+#endif /* INSTRUMENT_H */
\ No newline at end of file
@@ -0,0 +1,303 @@
+#ifndef MATCH_H
+#define MATCH_H
+
+#include <mcts/mcts_model.hpp>
+#include <mcts/evaluator.hpp>
+#include <mcts/parallel.hpp>
+#include <mcts/policy.hpp>
+#include <mcts/budget.hpp>
+#include <mcts/misc.hpp>
+#include <mcts/rng.hpp>
+#include <chess/chess.hpp>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Self-play between two configurations, many games at once
+namespace match
+{
+    // How a player searches, read from a config file like config.txt
+    struct Settings
+    {
+        int model = mcts_model::timed_model;
+        mcts_model::Options options{};
+        budget::Limits limits{};
+        int simulations = 10;
+        int rollout_policy = 0;
+        policy::rollout::HeuristicWeights weights{};
+        int max_moves = 1000;
+        int eval_queue_depth = 0;
+    };
+
+    // Settings from the keys of a config file, missing keys keep the config.txt meaning of 0
+    // With STATS_CACHE_VISITS above 0 every player of the settings shares the root statistics of stats_cache_file
+    // CAPTURE_WEIGHT and EVAL_SCALE are read from decimals when it has them, so they may be fractional
+    Settings settings_from_config(std::unordered_map<std::string, int>& dict, const std::string& stats_cache_file = stats_cache::DEFAULT_FILE, const std::unordered_map<std::string, double>& decimals = {})
+    {
+        auto decimal = [&dict, &decimals](const std::string& key)
+        {
+            auto value = decimals.find(key);
+            return value != decimals.end() ? value->second : double(dict[key]);
+        };
+        Settings settings{};
+        settings.model = dict["MODEL"];
+        int threads = std::max(dict["THREADS"], 1);
+        settings.options.n_threads = threads;
+        settings.options.reuse_tree = dict["REUSE_TREE"] != 0;
+        settings.options.table_size = static_cast<size_t>(dict["TT_SIZE"]);
+        settings.options.batch_size = std::max(dict["BATCH_SIZE"], 1);
+        // Only the single tree arena model selects batches, the others would silently search one leaf at a time
+        if(settings.options.batch_size > 1 && settings.model != mcts_model::arena_model)
+        {
+            std::cerr << "BATCH_SIZE=" << settings.options.batch_size << " is ignored by MODEL=" << settings.model << ", only MODEL=1 batches leaves" << std::endl;
+            settings.options.batch_size = 1;
+        }
+        settings.options.selection = dict["SELECTION"];
+        settings.options.memory_limit = static_cast<size_t>(std::max(dict["TREE_MEMORY_MB"], 0)) << 20;
+        settings.options.solver = dict["SOLVER"] != 0;
+        settings.options.stats_cache_visits = dict["STATS_CACHE_VISITS"];
+        if(settings.options.stats_cache_visits > 0)
+        {
+            auto cache = std::make_shared<stats_cache::Cache>(stats_cache_file);
+            if(cache->is_open()) settings.options.stats_cache = cache;
+        }
+        settings.limits = budget::Limits{dict["MAX_MCTS_ITERATIONS"], dict["SEARCH_MS"], static_cast<size_t>(dict["SEARCH_NODES"]), dict["EARLY_STOP"] != 0};
+        // Leaf parallel models split the simulations of a leaf between threads
+        int simulations = dict["ROLLOUT_SIMULATIONS"];
+        settings.simulations = settings.model == mcts_model::leaf_parallel_model ? (simulations + threads - 1) / threads : simulations;
+        settings.rollout_policy = dict["ROLLOUT_POLICY"];
+        double capture_weight = decimal("CAPTURE_WEIGHT");
+        double eval_scale = decimal("EVAL_SCALE");
+        settings.weights = policy::rollout::HeuristicWeights{capture_weight > 0.0 ? capture_weight : 1.0, dict["MVV_LVA"] != 0, dict["CUTOFF_DEPTH"], eval_scale > 0.0 ? eval_scale : 1.0};
+        settings.max_moves = dict["MAX_MOVES"];
+        settings.eval_queue_depth = dict["EVAL_QUEUE_DEPTH"];
+        // RAVE learns from the moves of its own playouts, which the evaluator does not return
+        if(settings.eval_queue_depth > 0 && settings.model == mcts_model::arena_model && settings.options.selection == selection::rave)
+        {
+            std::cerr << "EVAL_QUEUE_DEPTH=" << settings.eval_queue_depth << " is ignored by SELECTION=" << settings.options.selection << ", RAVE needs the moves of its playouts" << std::endl;
+            settings.eval_queue_depth = 0;
+        }
+        return settings;
+    }
+
+    // Model playing model_side as settings describe, seed fixes its random streams
+    std::unique_ptr<mcts_model::Model> make_player(const Settings& settings, chess::side model_side, std::uint64_t seed)
+    {
+        mcts_model::Options options = settings.options;
+        options.seed = seed;
+        std::unique_ptr<mcts_model::Model> model{settings.rollout_policy
+            ? mcts_model::make_model(settings.model, policy::rollout::HeuristicRollout{settings.simulations, settings.weights}, model_side, options)
+            : mcts_model::make_model(settings.model, policy::rollout::FastRollout{settings.simulations}, model_side, options)};
+        // Arena models roll batches of leaves out in lockstep
+        if(options.batch_size > 1)
+        {
+            if(auto arena_model = dynamic_cast<mcts_model::ArenaModelBase*>(model.get())) arena_model->set_batch_policy(policy::rollout::BatchRollout{settings.simulations});
+        }
+        // Or, in the single tree arena model, hand them to THREADS evaluator workers with up to eval_queue_depth of them in flight
+        if(settings.eval_queue_depth > 0 && settings.model == mcts_model::arena_model)
+        {
+            if(auto arena_model = dynamic_cast<mcts_model::ArenaModelBase*>(model.get()))
+            {
+                auto leaf_evaluator = std::make_shared<evaluator::BatchEvaluator>(policy::rollout::BatchRollout{settings.simulations}, model_side, options.batch_size, options.n_threads, 0, rng::stream_seed(seed, 3));
+                arena_model->set_evaluator(leaf_evaluator, static_cast<size_t>(settings.eval_queue_depth));
+            }
+        }
+        return model;
+    }
+
+    // FEN lines of an opening book, empty lines and lines starting with # are skipped
+    std::vector<std::string> load_book(const std::string& filename)
+    {
+        std::vector<std::string> book{};
+        std::ifstream is(filename);
+        std::string line;
+        while(std::getline(is, line))
+        {
+            if(!line.empty() && line.back() == '\r') line.pop_back();
+            if(line.empty() || line[0] == '#') continue;
+            book.push_back(line);
+        }
+        return book;
+    }
+
+    // One finished game, result is 1 if white won, -1 if black won and 0 for a draw
+    struct Game
+    {
+        int round = 0;
+        bool a_is_white = true;
+        std::string fen{};
+        std::vector<std::string> moves{};
+        int result = 0;
+        bool move_limit = false;
+    };
+
+    // PGN record of game between players a and b
+    // Moves are given in long algebraic notation, libchess has no SAN output
+    std::string to_pgn(const Game& game, const std::string& a, const std::string& b)
+    {
+        const char* result = game.result > 0 ? "1-0" : game.result < 0 ? "0-1" : "1/2-1/2";
+        std::string pgn = "[Event \"mcts-chess match\"]\n";
+        pgn += "[Round \"" + std::to_string(game.round) + "\"]\n";
+        pgn += "[White \"" + (game.a_is_white ? a : b) + "\"]\n";
+        pgn += "[Black \"" + (game.a_is_white ? b : a) + "\"]\n";
+        pgn += "[Result \"" + std::string{result} + "\"]\n";
+        if(game.fen != chess::position::fen_start) pgn += "[SetUp \"1\"]\n[FEN \"" + game.fen + "\"]\n";
+        if(game.move_limit) pgn += "[Termination \"move limit\"]\n";
+
+        // Side to move and move number are the second and sixth field of the FEN
+        std::istringstream fields(game.fen);
+        std::string board, turn, castling, en_passant;
+        int halfmove = 0, fullmove = 1;
+        fields >> board >> turn >> castling >> en_passant >> halfmove >> fullmove;
+        bool white_to_move = turn != "b";
+        std::string movetext{};
+        for(size_t i = 0 ; i < game.moves.size() ; ++i)
+        {
+            if(white_to_move) movetext += std::to_string(fullmove) + ". ";
+            else if(i == 0) movetext += std::to_string(fullmove) + "... ";
+            movetext += game.moves[i] + ' ';
+            if(!white_to_move) ++fullmove;
+            white_to_move = !white_to_move;
+        }
+        return pgn + '\n' + movetext + result + "\n\n";
+    }
+
+    // Elo difference of a score and the half width of its 95% confidence interval
+    struct Elo
+    {
+        double difference = 0;
+        double error = 0;
+    };
+
+    // Elo of the player with wins, draws and losses, the interval follows the spread of the game scores
+    Elo elo(int wins, int draws, int losses)
+    {
+        int games = wins + draws + losses;
+        if(games == 0) return Elo{};
+        double score = (wins + 0.5 * draws) / games;
+        double variance = (wins * std::pow(1.0 - score, 2) + draws * std::pow(0.5 - score, 2) + losses * std::pow(score, 2)) / games;
+        double margin = 1.96 * std::sqrt(variance / games);
+        auto to_elo = [](double p)
+        {
+            p = std::clamp(p, 1e-6, 1.0 - 1e-6);
+            return -400.0 * std::log10(1.0 / p - 1.0);
+        };
+        return Elo{to_elo(score), (to_elo(score + margin) - to_elo(score - margin)) / 2.0};
+    }
+
+    // Plays games between settings a and b on a work stealing pool, n_concurrent games at a time
+    // Every game has its own models seeded from seed and the game number, so a match replays game for game
+    // Openings come from the book in turn, each one played once with either colour
+    // Finished games are appended to pgn as they come in
+    class Runner
+    {
+        public:
+            Runner(Settings a, Settings b, std::string a_name, std::string b_name, std::vector<std::string> book, std::uint64_t seed = 0)
+                : a{a},
+                b{b},
+                a_name{a_name},
+                b_name{b_name},
+                book{book.empty() ? std::vector<std::string>{chess::position::fen_start} : book},
+                seed{seed}
+            {}
+
+            // Play games, returns them in round order
+            std::vector<Game> run(int games, int n_concurrent, std::ostream& pgn)
+            {
+                std::vector<Game> results(games);
+                Timer timer{};
+                {
+                    parallel::WorkStealingPool pool{n_concurrent};
+                    for(int round = 0 ; round < games ; ++round)
+                    {
+                        pool.submit([this, round, &results, &pgn]()
+                        {
+                            results[round] = play(round);
+                            std::lock_guard<std::mutex> lock{output_mutex};
+                            pgn << to_pgn(results[round], a_name, b_name) << std::flush;
+                        });
+                    }
+                    pool.wait();
+                    steals = pool.steals();
+                }
+                seconds = timer.get_time();
+                return results;
+            }
+
+            // Score of a, games/hour and Elo of a against b
+            std::string report(const std::vector<Game>& games) const
+            {
+                int wins{0}, draws{0}, losses{0};
+                for(const Game& game : games)
+                {
+                    int result = game.a_is_white ? game.result : -game.result;
+                    if(result > 0) ++wins;
+                    else if(result < 0) ++losses;
+                    else ++draws;
+                }
+                Elo a_elo = elo(wins, draws, losses);
+                std::string report = "-- Match Report --";
+                report += "\n" + a_name + " vs " + b_name + " w/d/l: " + std::to_string(wins) + '/' + std::to_string(draws) + '/' + std::to_string(losses);
+                report += "\ngames: " + std::to_string(games.size());
+                report += "\nseconds: " + std::to_string(seconds);
+                report += "\ngames/hour: " + std::to_string(seconds > 0 ? games.size() * 3600.0 / seconds : 0.0);
+                report += "\nsteals: " + std::to_string(steals);
+                report += "\nelo: " + std::to_string(a_elo.difference) + " +/- " + std::to_string(a_elo.error);
+                return report;
+            }
+
+        private:
+            // Play game number round, a has white in even rounds
+            Game play(int round)
+            {
+                Game game{};
+                game.round = round + 1;
+                game.a_is_white = round % 2 == 0;
+                game.fen = book[(round / 2) % book.size()];
+                const Settings& white_settings = game.a_is_white ? a : b;
+                const Settings& black_settings = game.a_is_white ? b : a;
+                std::uint64_t game_seed = rng::stream_seed(seed, round);
+                std::unique_ptr<mcts_model::Model> white{make_player(white_settings, chess::side::side_white, rng::stream_seed(game_seed, 1))};
+                std::unique_ptr<mcts_model::Model> black{make_player(black_settings, chess::side::side_black, rng::stream_seed(game_seed, 2))};
+                int max_moves = std::max(a.max_moves, b.max_moves);
+
+                chess::position game_board = chess::position::from_fen(game.fen);
+                while(!game_board.is_checkmate() && !game_board.is_stalemate())
+                {
+                    if(max_moves > 0 && static_cast<int>(game.moves.size()) >= 2 * max_moves)
+                    {
+                        game.move_limit = true;
+                        break;
+                    }
+                    bool white_to_move = game_board.get_turn() == chess::side::side_white;
+                    mcts_model::Model& mover = white_to_move ? *white : *black;
+                    chess::move move{mover.search(game_board, white_to_move ? white_settings.limits : black_settings.limits)};
+                    game.moves.push_back(move.to_lan());
+                    game_board.make_move(move);
+                    white->advance(move);
+                    black->advance(move);
+                }
+                if(game_board.is_checkmate()) game.result = game_board.get_turn() == chess::side::side_white ? -1 : 1;
+                return game;
+            }
+
+            Settings a;
+            Settings b;
+            std::string a_name;
+            std::string b_name;
+            std::vector<std::string> book;
+            std::uint64_t seed;
+            std::mutex output_mutex{};
+            size_t steals{0};
+            double seconds{0};
+    };
+}
+
+#endif /* MATCH_H */
\ No newline at end of file
@@ -2,105 +2,840 @@
 #define MODEL_H
 
 #include <mcts/node.hpp>
+#include <mcts/arena.hpp>
+#include <mcts/parallel.hpp>
+#include <mcts/budget.hpp>
+#include <mcts/evaluator.hpp>
 #include <mcts/misc.hpp>
+#include <mcts/instrument.hpp>
+#include <mcts/rng.hpp>
+#include <mcts/selection.hpp>
+#include <mcts/stats_cache.hpp>
 #include <chess/chess.hpp>
 #include <memory>
 #include <string>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
 
 namespace mcts_model
 {
     using policy_function_type = node::policy_function_type;
+    using batch_policy_function_type = node::batch_policy_function_type;
 
     // Model struct to simplify usage of the search
+    // seed fixes the random streams, two models with the same seed and moves search the same way
     struct Model
     {
-        Model(policy_function_type rollout_policy, chess::side model_side) 
+        Model(policy_function_type rollout_policy, chess::side model_side, std::uint64_t seed = 0) 
             : rollout_policy{rollout_policy},
-            model_side{model_side}
+            model_side{model_side},
+            seed{seed}
         {}
+        virtual ~Model() = default;
 
-        virtual chess::move search(chess::position state, int max_iter)
+        // Tell the model about a move played on the board since its last search
+        virtual void advance(chess::move move) {}
+
+        // Search with at most max_iter iterations
+        chess::move search(chess::position state, int max_iter)
+        {
+            return search(state, budget::Limits{max_iter});
+        }
+
+        // Search until one of the limits is reached, last_usage tells how much of them was used
+        virtual chess::move search(chess::position state, const budget::Limits& limits)
         {
+            budget::Budget search_budget{limits, max_score()};
+            playout.generator.seed(next_search_seed());
+            size_t nodes{1};
             std::shared_ptr<node::Node> main_node{std::make_shared<node::Node>(state, model_side)};
+            node::Node::Path path{};
             main_node->expand();
-            for(int i = 0 ; i < max_iter ; ++i)
+            while(search_budget.next([&nodes]() { return nodes; }, [&main_node]() { return main_node->leader_gap(); }))
             {
-                std::shared_ptr<node::Node> current_node = main_node->traverse();
+                path.assign(1, main_node.get());
+                std::shared_ptr<node::Node> current_node = main_node->traverse(path);
                 if(current_node->is_over()) break;
+                // Selection widened a node if it ends on a child without visits, otherwise the leaf is expanded
                 if(current_node->get_n() != 0)
                 {
                     current_node->expand();
-                    current_node = current_node->get_children().front();
+                    if(!current_node->has_untried_moves()) continue;
+                    current_node = current_node->widen(path);
                 }
-                current_node->rollout(rollout_policy);
-                current_node->backpropagate();
+                ++nodes;
+                double score = current_node->rollout(rollout_policy, playout);
+                node::Node::backpropagate(path, score);
             }
+            last_usage = search_budget.usage(nodes);
             return main_node->best_move();
         }
 
+        // Line of the search tree starting with the move the search would play, empty for models that do not keep one
+        // Safe to call from the thread the search calls budget::Limits::info on
+        virtual std::vector<chess::move> principal_variation() const
+        {
+            return {};
+        }
+
+        // A root child score moves by at most one win or draw per iteration
+        static double max_score()
+        {
+            return std::max(std::abs(node::Node::WIN_SCORE), std::abs(node::Node::DRAW_SCORE));
+        }
+
+        // Seed of the next search, workers derive their own stream from it with rng::stream_seed
+        std::uint64_t next_search_seed()
+        {
+            return rng::stream_seed(seed, search_index++);
+        }
+
         policy_function_type rollout_policy;
         chess::side model_side;
+        std::uint64_t seed;
+        std::uint64_t search_index{0};
+        node::Playout playout{};
+        budget::Usage last_usage{};
+        // Counters and phase timings of the last search, filled by TimedModel and the arena models
+        instrument::SearchStats last_stats{};
     };
-    // Tracks time spent on different steps of MCTS search
-    struct TimedModel : public Model
+    // Time spent on the different steps of MCTS search, shared by every BasicTimedModel
+    // Step times are estimated from the sampled iterations of instrument::SearchStats
+    // With a memory_limit the tree is pruned once its bytes exceed it, see prune_tree
+    // With solver mate and stalemate results are backed up with node::Node::solve and a proven root ends the search
+    // With reuse_tree the node reached by the moves passed to advance() becomes the root of the next search
+    // The rollout policy lives in BasicTimedModel, the type erased one of Model stays empty
+    struct TimedModelBase : public Model
     {
-        TimedModel(policy_function_type rollout_policy, chess::side model_side) 
-        : Model{rollout_policy, model_side}
+        TimedModelBase(chess::side model_side, std::uint64_t seed = 0, size_t memory_limit = 0, bool solver = false, bool reuse_tree = false)
+            : Model{policy_function_type{}, model_side, seed},
+            memory_limit{memory_limit},
+            solver{solver},
+            reuse_tree{reuse_tree}
         {}
 
-        chess::move search(chess::position state, int max_iter) override
+        void advance(chess::move move) override
         {
-            outer_timer.set_start();
+            if(reuse_tree && main_node) played_moves.push_back(move);
+        }
 
-            std::shared_ptr<node::Node> main_node{std::make_shared<node::Node>(state, model_side)};
-            inner_timer.set_start();
-            main_node->expand();
-            t_expanding += inner_timer.get_time();
-            for(int i = 0 ; i < max_iter ; ++i)
+        // Make main_node the root of the search of state, the kept node of the played moves if there is one and a new node otherwise
+        // The rest of the old tree is released once the kept node is detached from it
+        void prepare_tree(const chess::position& state)
+        {
+            std::shared_ptr<node::Node> kept{reuse_tree ? main_node : nullptr};
+            for(const chess::move& move : played_moves)
             {
-                inner_timer.set_start();
-                std::shared_ptr<node::Node> current_node = main_node->traverse();
-                t_traversing += inner_timer.get_time();
-                if(current_node->is_over()) break;
-                if(current_node->get_n() != 0)
-                {
-                    inner_timer.set_start();
-                    current_node->expand();
-                    t_expanding += inner_timer.get_time();
-                    current_node = current_node->get_children().front();
-                }
-                inner_timer.set_start();
-                current_node->rollout(rollout_policy);
-                t_rollouting += inner_timer.get_time(true);
-                current_node->backpropagate();
-                t_backpropping += inner_timer.get_time();
+                if(!kept) break;
+                kept = kept->find_child(move);
+            }
+            played_moves.clear();
+            main_node.reset();
+            inherited_visits = 0;
+            if(kept && transposition::hash(kept->get_state()) == transposition::hash(state))
+            {
+                kept->make_root();
+                inherited_visits = kept->get_n();
+                main_node = kept;
+            }
+            else
+            {
+                main_node = std::make_shared<node::Node>(state, model_side, &tree_memory);
+            }
+            if(!main_node->is_expanded()) main_node->expand();
+            total_inherited_visits += inherited_visits;
+            ++searches;
+        }
 
-                
+        // Line of the tree of the running search, or of the last one with reuse_tree
+        std::vector<chess::move> principal_variation() const override
+        {
+            if(!main_node) return {};
+            return main_node->principal_variation(solver);
+        }
+
+        // Visits the searches inherited from previous trees
+        std::string reuse_report() const
+        {
+            std::string report = "-- Reuse Report --";
+            report += "\nlast search inherited visits: " + std::to_string(inherited_visits);
+            report += "\naverage inherited visits: " + std::to_string(searches ? total_inherited_visits / double(searches) : 0.0);
+            return report;
+        }
+
+        // Collapse subtrees of ever more visits into leaves until the tree is back under 3/4 of memory_limit
+        // Returns false if the root and its children alone exceed that, the search then stops growing the tree
+        bool prune_tree(node::Node& main_node)
+        {
+            tree_memory.prunes.fetch_add(1, std::memory_order_relaxed);
+            long target = static_cast<long>(memory_limit / 4 * 3);
+            for(long min_visits = 2 ; ; min_visits *= 2)
+            {
+                main_node.prune(static_cast<int>(std::min<long>(min_visits, std::numeric_limits<int>::max())));
+                if(tree_memory.bytes.load(std::memory_order_relaxed) <= target) return true;
+                if(min_visits > main_node.get_n()) return false;
             }
-            t_tot += outer_timer.get_time();
-            
-            return main_node->best_move();
         }
 
-        Timer inner_timer{};
-        Timer outer_timer{};
-        double t_expanding{0};
-        double t_traversing{0};
-        double t_rollouting{0};
-        double t_backpropping{0};
-        double t_tot{0};
+        // Whether the tree is over memory_limit
+        bool over_memory_limit() const
+        {
+            return memory_limit && tree_memory.bytes.load(std::memory_order_relaxed) > static_cast<long>(memory_limit);
+        }
+
+        instrument::SearchStats total_stats{};
+        // Live nodes and bytes of the tree, readable while a search runs
+        node::TreeMemory tree_memory{};
+        size_t memory_limit;
+        bool solver;
+        bool reuse_tree;
+        // Root of the last search, kept until the next one with reuse_tree
+        std::shared_ptr<node::Node> main_node{};
+        std::vector<chess::move> played_moves{};
+        int inherited_visits{0};
+        long total_inherited_visits{0};
+        int searches{0};
 
         std::string time_report() 
         {
+            double t_expanding = total_stats.phase_seconds(instrument::expand_phase);
+            double t_traversing = total_stats.phase_seconds(instrument::select_phase);
+            double t_rollouting = total_stats.phase_seconds(instrument::rollout_phase);
+            double t_backpropping = total_stats.phase_seconds(instrument::backprop_phase);
             std::string report = "-- Time Report --";
             report += "\nexpanding: " + std::to_string(t_expanding);
             report += "\ntraversing: " + std::to_string(t_traversing);
             report += "\nrolling out: " + std::to_string(t_rollouting);
             report += "\nbackpropagating: " + std::to_string(t_backpropping);
-            report += "\neverything else: " + std::to_string(t_tot-t_expanding-t_traversing-t_rollouting-t_backpropping);
+            report += "\neverything else: " + std::to_string(total_stats.seconds-t_expanding-t_traversing-t_rollouting-t_backpropping);
+            return report;
+        }
+    };
+    // Tracks time spent on different steps of MCTS search
+    // Policy is called by reference from the search loop, a concrete policy type is dispatched statically
+    // The model owns its policy, so scratch state lives across rollouts instead of being copied into each
+    template<node::RolloutPolicy Policy>
+    struct BasicTimedModel : public TimedModelBase
+    {
+        BasicTimedModel(Policy rollout_policy, chess::side model_side, std::uint64_t seed = 0, size_t memory_limit = 0, bool solver = false, bool reuse_tree = false) 
+        : TimedModelBase{model_side, seed, memory_limit, solver, reuse_tree},
+        policy{rollout_policy}
+        {}
+
+        using Model::search;
+        chess::move search(chess::position state, const budget::Limits& limits) override
+        {
+            last_stats.start();
+
+            budget::Budget search_budget{limits, max_score()};
+            playout.generator.seed(next_search_seed());
+            prepare_tree(state);
+            node::Node::Path path{};
+            if(!inherited_visits) last_stats.add_nodes(1);
+            bool grow{true};
+            auto live_nodes = [this]() { return static_cast<size_t>(tree_memory.nodes.load(std::memory_order_relaxed)); };
+            while(search_budget.next(live_nodes, [this]() { return main_node->leader_gap(); }))
+            {
+                if(grow && over_memory_limit()) grow = prune_tree(*main_node);
+                bool sampled = last_stats.next_iteration();
+                std::shared_ptr<node::Node> current_node{};
+                {
+                    instrument::ScopedTimer timer{last_stats, instrument::select_phase, sampled};
+                    path.assign(1, main_node.get());
+                    current_node = main_node->traverse(path, grow);
+                }
+                if(current_node->is_over()) break;
+                // Selection widened a node if it ends on a child without visits, otherwise the leaf is expanded
+                // A tree that may not grow rolls out from its leaves again
+                if(current_node->get_n() == 0 || grow)
+                {
+                    if(current_node->get_n() != 0)
+                    {
+                        instrument::ScopedTimer timer{last_stats, instrument::expand_phase, sampled};
+                        current_node->expand();
+                        if(!current_node->has_untried_moves()) continue;
+                        current_node = current_node->widen(path);
+                    }
+                    last_stats.add_nodes(1);
+                }
+                if(sampled) last_stats.add_depth(path.size() - 1);
+                std::uint64_t plies = playout.plies;
+                double score;
+                {
+                    instrument::ScopedTimer timer{last_stats, instrument::rollout_phase, sampled};
+                    score = current_node->rollout(policy, playout, solver);
+                }
+                last_stats.add_rollouts(1, playout.plies - plies);
+                instrument::ScopedTimer timer{last_stats, instrument::backprop_phase, sampled};
+                node::Node::backpropagate(path, score);
+                // Nothing is left to search once the root is proven
+                if(solver && current_node->is_proven() && node::Node::solve(path)) break;
+            }
+            last_stats.finish();
+            total_stats.merge(last_stats);
+            last_usage = search_budget.usage(live_nodes(), static_cast<size_t>(tree_memory.bytes.load(std::memory_order_relaxed)));
+            last_usage.proven = main_node->is_proven();
+            chess::move best_move = main_node->best_move(solver);
+            if(!reuse_tree) main_node.reset();
+            return best_move;
+        }
+
+        Policy policy;
+    };
+    using TimedModel = BasicTimedModel<policy_function_type>;
+    // Settings of the arena models
+    // cache_visits sets how often a node is visited before its position is cached, 0 caches all
+    // reuse_tree keeps the subtree of the moves passed to advance() for the next search
+    // table_size is the amount of transposition table entries, 0 keeps the tree a tree
+    // seed fixes the random streams of every search and worker
+    // batch_size is the amount of leaves an ArenaModel selects before rolling them out together
+    // selection picks the selection policy of the single tree arena model, a selection::selection_type
+    // memory_limit caps the bytes of the tree of the single thread node tree model, 0 leaves it unbounded
+    // solver makes the node tree model prove wins, losses and draws and stop once its root is proven
+    // snapshot_file receives the tree of the arena models after every search, their first search resumes from it if it is of the same position
+    // stats_cache keeps root statistics between searches and processes, a new tree starts from at most stats_cache_visits of them
+    struct Options
+    {
+        int n_threads = 1;
+        int cache_visits = arena::Tree::DEFAULT_CACHE_VISITS;
+        bool reuse_tree = false;
+        size_t table_size = 0;
+        std::uint64_t seed = 0;
+        int batch_size = 1;
+        int selection = selection::ucb1;
+        std::shared_ptr<stats_cache::Cache> stats_cache{};
+        int stats_cache_visits = 0;
+        size_t memory_limit = 0;
+        bool solver = false;
+        std::string snapshot_file{};
+    };
+    // What every arena model offers, whatever selection policy its tree uses
+    // Holds the tree reuse bookkeeping and the leaf batches, the tree lives in BasicArenaModel
+    struct ArenaModelBase : public Model
+    {
+        ArenaModelBase(policy_function_type rollout_policy, chess::side model_side, const Options& options)
+        : Model{rollout_policy, model_side, options.seed},
+        reuse_tree{options.reuse_tree},
+        batch_cursors(std::max(options.batch_size, 1)),
+        stats_cache{options.stats_cache},
+        stats_cache_visits{options.stats_cache_visits},
+        snapshot_file{options.snapshot_file}
+        {}
+
+        void advance(chess::move move) override
+        {
+            if(reuse_tree) played_moves.push_back(move);
+        }
+
+        // Roll batches out with batch_policy, without one every leaf of a batch goes through rollout_policy
+        void set_batch_policy(batch_policy_function_type policy)
+        {
+            batch_policy = policy;
+        }
+
+        // Score leaves with leaf_evaluator instead, keeping up to queue_depth of them in flight under virtual loss
+        // Only the single tree search of BasicArenaModel submits leaves, the evaluator has to score for model_side
+        // An evaluator returns scores without the moves of its playouts, so a selection policy with AMAF statistics
+        // keeps rolling leaves out itself and the evaluator is rejected with false
+        bool set_evaluator(std::shared_ptr<evaluator::Evaluator> leaf_evaluator, size_t queue_depth)
+        {
+            if(uses_amaf()) return false;
+            this->leaf_evaluator = leaf_evaluator;
+            evaluator_cursors.resize(std::max<size_t>(queue_depth, 1));
+            return true;
+        }
+
+        // Whether the selection policy of the tree collects all-moves-as-first statistics from playouts
+        virtual bool uses_amaf() const = 0;
+
+        // Hit rate of the transposition table
+        virtual std::string transposition_report() = 0;
+
+        // Visits the searches inherited from previous trees
+        std::string reuse_report() const
+        {
+            std::string report = "-- Reuse Report --";
+            report += "\nlast search inherited visits: " + std::to_string(inherited_visits);
+            report += "\naverage inherited visits: " + std::to_string(searches ? total_inherited_visits / double(searches) : 0.0);
             return report;
         }
+
+        arena::Cursor cursor{};
+        std::uint64_t search_seed{0};
+        bool reuse_tree;
+        batch_policy_function_type batch_policy{};
+        std::vector<arena::Cursor> batch_cursors;
+        std::vector<chess::position> batch_states{};
+        std::vector<double> batch_scores{};
+        std::shared_ptr<evaluator::Evaluator> leaf_evaluator{};
+        std::vector<arena::Cursor> evaluator_cursors{};
+        std::vector<evaluator::Result> evaluator_results{};
+        std::vector<std::uint64_t> free_cursors{};
+        std::vector<chess::move> played_moves{};
+        int inherited_visits{0};
+        long total_inherited_visits{0};
+        int searches{0};
+        std::string last_memory_report{};
+        size_t last_tree_bytes{0};
+        std::shared_ptr<stats_cache::Cache> stats_cache;
+        int stats_cache_visits;
+        // Position hash of the root and visits and scores of its children when the search started
+        std::uint64_t stats_cache_key{0};
+        std::vector<std::pair<int, double>> stats_cache_start{};
+        std::string snapshot_file;
     };
+    // Same search as Model, but the tree lives in a per-search arena
+    // Every node is released at once when search returns, unless reuse_tree is set
+    // With a batch_size above 1 leaves are selected under virtual loss and rolled out as one batch
+    // Selection is the selection policy of the tree, see selection.hpp
+    template<typename Selection>
+    struct BasicArenaModel : public ArenaModelBase
+    {
+        BasicArenaModel(policy_function_type rollout_policy, chess::side model_side, const Options& options = Options{})
+        : ArenaModelBase{rollout_policy, model_side, options},
+        tree{model_side, options.cache_visits, options.table_size}
+        {
+            if(batch_cursors.size() > 1) tree.virtual_loss = true;
+        }
+
+        using Model::search;
+        chess::move search(chess::position state, const budget::Limits& limits) override
+        {
+            budget::Budget search_budget{limits, max_score()};
+            prepare_tree(state);
+            if(leaf_evaluator)
+            {
+                tree.virtual_loss = true;
+                search_async(search_budget);
+            }
+            else if(batch_cursors.size() > 1)
+            {
+                search_batched(search_budget);
+            }
+            else
+            {
+                while(next_iteration(search_budget))
+                {
+                    if(!tree.iterate(cursor, rollout_policy, &last_stats)) break;
+                }
+            }
+            return finish_search(search_budget);
+        }
+
+        // Select up to batch_size leaves, roll them out together and back every score up
+        void search_batched(budget::Budget& search_budget)
+        {
+            bool searching{true};
+            while(searching)
+            {
+                batch_states.clear();
+                while(batch_states.size() < batch_cursors.size())
+                {
+                    arena::Cursor& leaf_cursor = batch_cursors[batch_states.size()];
+                    if(!next_iteration(search_budget))
+                    {
+                        searching = false;
+                        break;
+                    }
+                    bool sampled = last_stats.next_iteration();
+                    instrument::ScopedTimer timer{last_stats, instrument::select_phase, sampled};
+                    if(!tree.select(leaf_cursor))
+                    {
+                        searching = false;
+                        break;
+                    }
+                    if(sampled) last_stats.add_depth(leaf_cursor.path.size() - 1);
+                    batch_states.push_back(leaf_cursor.state);
+                }
+                if(batch_states.empty()) break;
+                bool sampled = last_stats.next_batch();
+                std::uint64_t plies = cursor.playout.plies;
+                {
+                    instrument::ScopedTimer timer{last_stats, instrument::rollout_phase, sampled};
+                    if(batch_policy)
+                    {
+                        batch_policy(batch_states, model_side, cursor.playout, batch_scores);
+                    }
+                    else
+                    {
+                        batch_scores.resize(batch_states.size());
+                        for(size_t i = 0 ; i < batch_states.size() ; ++i) batch_scores[i] = rollout_policy(batch_states[i], model_side, cursor.playout);
+                    }
+                }
+                last_stats.add_rollouts(batch_states.size(), cursor.playout.plies - plies);
+                instrument::ScopedTimer timer{last_stats, instrument::backprop_phase, sampled};
+                for(size_t i = 0 ; i < batch_states.size() ; ++i) tree.update(batch_cursors[i], batch_scores[i]);
+            }
+        }
+
+        // Submit selected leaves to leaf_evaluator until every cursor is in flight, then back up the scores that come in
+        // The evaluator is flushed before waiting, so a queue shallower than its batches does not stall
+        void search_async(budget::Budget& search_budget)
+        {
+            free_cursors.clear();
+            for(size_t i = evaluator_cursors.size() ; i-- > 0 ;) free_cursors.push_back(i);
+            size_t in_flight{0};
+            bool searching{true};
+            while(true)
+            {
+                while(searching && !free_cursors.empty())
+                {
+                    arena::Cursor& leaf_cursor = evaluator_cursors[free_cursors.back()];
+                    if(!next_iteration(search_budget))
+                    {
+                        searching = false;
+                        break;
+                    }
+                    bool sampled = last_stats.next_iteration();
+                    instrument::ScopedTimer timer{last_stats, instrument::select_phase, sampled};
+                    if(!tree.select(leaf_cursor))
+                    {
+                        searching = false;
+                        break;
+                    }
+                    if(sampled) last_stats.add_depth(leaf_cursor.path.size() - 1);
+                    leaf_evaluator->submit(free_cursors.back(), leaf_cursor.state);
+                    free_cursors.pop_back();
+                    ++in_flight;
+                }
+                if(in_flight == 0) break;
+                leaf_evaluator->flush();
+                evaluator_results.clear();
+                leaf_evaluator->collect(evaluator_results, true);
+                bool sampled = last_stats.next_batch();
+                instrument::ScopedTimer timer{last_stats, instrument::backprop_phase, sampled};
+                for(const evaluator::Result& result : evaluator_results)
+                {
+                    tree.update(evaluator_cursors[result.ticket], result.score);
+                    free_cursors.push_back(result.ticket);
+                }
+                in_flight -= evaluator_results.size();
+                last_stats.add_rollouts(evaluator_results.size(), 0);
+            }
+        }
+
+        // Keep the subtree of the played moves or start a new tree
+        void prepare_tree(const chess::position& state)
+        {
+            last_stats.start();
+            inherited_visits = 0;
+            if((reuse_tree && !played_moves.empty() && tree.reroot(played_moves, cursor, state)) || resume_tree(state))
+            {
+                inherited_visits = tree[arena::Tree::root].n;
+            }
+            else
+            {
+                tree.start(cursor, state);
+                if(stats_cache) preload_stats(state);
+            }
+            if(stats_cache) snapshot_stats(state);
+            played_moves.clear();
+            start_nodes = tree.size();
+            total_inherited_visits += inherited_visits;
+            ++searches;
+            search_seed = next_search_seed();
+            cursor.playout.generator.seed(rng::stream_seed(search_seed, 0));
+        }
+
+        // Claim an iteration of search_budget for the tree
+        bool next_iteration(budget::Budget& search_budget)
+        {
+            return search_budget.next([this]() { return tree.size(); }, [this]() { return tree.leader_gap(); });
+        }
+
+        // Pick the best move and release the tree unless it is kept for the next search
+        chess::move finish_search(const budget::Budget& search_budget)
+        {
+            last_usage = search_budget.usage(tree.size(), tree.bytes());
+            last_stats.add_nodes(tree.size() - start_nodes);
+            last_stats.finish();
+            chess::move best_move = tree.best_move();
+            last_memory_report = tree.memory_report();
+            last_tree_bytes = tree.bytes();
+            if(stats_cache) merge_stats();
+            if(!snapshot_file.empty()) snapshot::write(snapshot_file, tree.save());
+            if(!reuse_tree) tree.clear();
+            return best_move;
+        }
+
+        // Continue the tree of snapshot_file on the first search, if it was saved from state
+        bool resume_tree(const chess::position& state)
+        {
+            if(snapshot_file.empty() || searches != 0) return false;
+            snapshot::Snapshot saved{};
+            return snapshot::read(snapshot_file, saved) && tree.restore(saved, cursor, state);
+        }
+
+        // Give the root children of a new tree their cached visits and scores
+        // Moves visited more than stats_cache_visits times in total are scaled down, keeping their mean scores
+        void preload_stats(const chess::position& state)
+        {
+            const auto& root_node = tree[arena::Tree::root];
+            if(!root_node.has_children() || stats_cache_visits <= 0) return;
+            stats_cache->read(transposition::hash(state), [this, &root_node](const stats_cache::Record& record)
+            {
+                std::uint64_t total{0};
+                for(std::uint32_t i = 0 ; i < record.n_moves ; ++i) total += record.moves[i].n;
+                if(total == 0) return;
+                double scale = std::min(1.0, stats_cache_visits / double(total));
+                for(arena::index_type i = root_node.first_child ; i < root_node.first_child + root_node.n_children ; ++i)
+                {
+                    std::string lan = tree[i].move.to_lan();
+                    for(std::uint32_t j = 0 ; j < record.n_moves ; ++j)
+                    {
+                        const stats_cache::MoveStats& move_stats = record.moves[j];
+                        if(move_stats.n == 0 || lan != move_stats.lan) continue;
+                        int n = static_cast<int>(std::lround(move_stats.n * scale));
+                        if(n > 0) tree.add_root_visits(i, n, move_stats.t * n / move_stats.n);
+                        break;
+                    }
+                }
+            });
+        }
+
+        // Remember the root children statistics the search starts from, kept trees included
+        void snapshot_stats(const chess::position& state)
+        {
+            stats_cache_key = transposition::hash(state);
+            stats_cache_start.clear();
+            const auto& root_node = tree[arena::Tree::root];
+            if(!root_node.has_children()) return;
+            for(arena::index_type i = root_node.first_child ; i < root_node.first_child + root_node.n_children ; ++i)
+            {
+                const auto& child = tree[tree.resolve(i)];
+                stats_cache_start.emplace_back(child.n.load(std::memory_order_relaxed), child.t.load(std::memory_order_relaxed));
+            }
+        }
+
+        // Add what this search found at the root to the cache
+        void merge_stats()
+        {
+            const auto& root_node = tree[arena::Tree::root];
+            if(!root_node.has_children() || stats_cache_start.size() != root_node.n_children) return;
+            std::vector<stats_cache::MoveStats> deltas{};
+            for(arena::index_type i = 0 ; i < root_node.n_children ; ++i)
+            {
+                const auto& child = tree[tree.resolve(root_node.first_child + i)];
+                int n = child.n.load(std::memory_order_relaxed) - stats_cache_start[i].first;
+                if(n <= 0) continue;
+                stats_cache::MoveStats delta{};
+                std::string lan = tree[root_node.first_child + i].move.to_lan();
+                std::strncpy(delta.lan, lan.c_str(), sizeof(delta.lan) - 1);
+                delta.t = child.t.load(std::memory_order_relaxed) - stats_cache_start[i].second;
+                delta.n = static_cast<std::uint64_t>(n);
+                deltas.push_back(delta);
+            }
+            stats_cache->merge(stats_cache_key, deltas);
+        }
+
+        std::string transposition_report() override
+        {
+            return tree.table.report();
+        }
+
+        bool uses_amaf() const override
+        {
+            return Selection::uses_amaf;
+        }
+
+        std::vector<chess::move> principal_variation() const override
+        {
+            return tree.principal_variation();
+        }
+
+        arena::BasicTree<Selection> tree;
+        size_t start_nodes{0};
+    };
+    using ArenaModel = BasicArenaModel<selection::UCB1>;
+    // Tree parallel search, n_threads workers share one arena tree
+    // Workers put a virtual loss on their selected path so they spread over different branches
+    // Every worker rolls out with its own copy of the rollout policy and its own random stream
+    struct ParallelModel : public ArenaModel
+    {
+        ParallelModel(policy_function_type rollout_policy, chess::side model_side, const Options& options = Options{})
+        : ArenaModel{rollout_policy, model_side, options},
+        n_threads{std::max(options.n_threads, 1)}
+        {
+            tree.virtual_loss = true;
+        }
+
+        using Model::search;
+        chess::move search(chess::position state, const budget::Limits& limits) override
+        {
+            budget::Budget search_budget{limits, max_score()};
+            prepare_tree(state);
+            std::atomic<bool> over{false};
+            std::vector<std::thread> workers{};
+            for(int i = 0 ; i < n_threads ; ++i)
+            {
+                workers.emplace_back([this, &search_budget, &over, i]()
+                {
+                    policy_function_type worker_policy{rollout_policy};
+                    arena::Cursor worker_cursor{};
+                    worker_cursor.playout.generator.seed(rng::stream_seed(search_seed, i));
+                    while(!over.load(std::memory_order_relaxed) && next_iteration(search_budget))
+                    {
+                        if(!tree.iterate(worker_cursor, worker_policy)) over.store(true, std::memory_order_relaxed);
+                    }
+                });
+            }
+            for(std::thread& worker : workers) worker.join();
+            return finish_search(search_budget);
+        }
+
+        int n_threads;
+    };
+    // Root parallel search, every worker builds its own arena tree from the same root
+    // Iteration and node limits are split between workers, every worker gets the full time limit
+    // Root statistics are summed per move and the move with the most merged visits is played
+    struct RootParallelModel : public Model
+    {
+        RootParallelModel(policy_function_type rollout_policy, chess::side model_side, const Options& options = Options{})
+        : Model{rollout_policy, model_side, options.seed}
+        {
+            for(int i = 0 ; i < std::max(options.n_threads, 1) ; ++i)
+            {
+                trees.push_back(std::make_unique<arena::Tree>(model_side, options.cache_visits, options.table_size));
+            }
+        }
+
+        using Model::search;
+        chess::move search(chess::position state, const budget::Limits& limits) override
+        {
+            int n_trees = static_cast<int>(trees.size());
+            budget::Limits worker_limits{(limits.iterations + n_trees - 1) / n_trees, limits.milliseconds, (limits.nodes + n_trees - 1) / n_trees};
+            worker_limits.stop = limits.stop;
+            std::vector<budget::Usage> usages(trees.size());
+            std::uint64_t search_seed = next_search_seed();
+            std::vector<std::thread> workers{};
+            for(size_t i = 0 ; i < trees.size() ; ++i)
+            {
+                workers.emplace_back([this, &state, &worker_limits, &usages, search_seed, i]()
+                {
+                    arena::Tree& tree = *trees[i];
+                    budget::Budget search_budget{worker_limits, max_score()};
+                    policy_function_type worker_policy{rollout_policy};
+                    arena::Cursor worker_cursor{};
+                    worker_cursor.playout.generator.seed(rng::stream_seed(search_seed, i));
+                    tree.start(worker_cursor, state);
+                    while(search_budget.next([&tree]() { return tree.size(); }, []() { return 0.0; }))
+                    {
+                        if(!tree.iterate(worker_cursor, worker_policy)) break;
+                    }
+                    usages[i] = search_budget.usage(tree.size());
+                });
+            }
+            for(std::thread& worker : workers) worker.join();
+            last_usage = budget::Usage{};
+            for(const budget::Usage& usage : usages)
+            {
+                last_usage.iterations += usage.iterations;
+                last_usage.milliseconds = std::max(last_usage.milliseconds, usage.milliseconds);
+                last_usage.nodes += usage.nodes;
+            }
+
+            // Every tree expanded the same root, so children line up move by move, ties go to the higher merged score
+            // Children found in the transposition table hold their statistics in the node they link to
+            const arena::Node& main_node = (*trees.front())[arena::Tree::root];
+            arena::index_type best = 0;
+            std::vector<double> merged_t(main_node.n_children, 0.0);
+            std::vector<long> merged_n(main_node.n_children, 0);
+            for(std::unique_ptr<arena::Tree>& tree : trees)
+            {
+                const arena::Node& root_node = (*tree)[arena::Tree::root];
+                for(arena::index_type i = 0 ; i < root_node.n_children ; ++i)
+                {
+                    const arena::Node& child = (*tree)[tree->resolve(root_node.first_child + i)];
+                    merged_t[i] += child.t.load(std::memory_order_relaxed);
+                    merged_n[i] += child.n.load(std::memory_order_relaxed);
+                }
+            }
+            for(arena::index_type i = 0 ; i < main_node.n_children ; ++i)
+            {
+                if(merged_n[i] > merged_n[best] || (merged_n[i] == merged_n[best] && merged_t[i] > merged_t[best])) best = i;
+            }
+            chess::move best_move = (*trees.front())[main_node.first_child + best].move;
+            for(std::unique_ptr<arena::Tree>& tree : trees) tree->clear();
+            return best_move;
+        }
+
+        std::vector<std::unique_ptr<arena::Tree>> trees{};
+    };
+    // Leaf parallel search, one tree where every rollout runs on all workers of a thread pool
+    // Each worker plays rollout_policy from the leaf with its own copy, the scores are averaged
+    // Worker streams are reseeded from the tree's generator for every leaf, which keeps them reproducible
+    // Moves recorded by the workers are handed on together
+    // Bind the policy to ROLLOUT_SIMULATIONS / n_threads games to keep the playouts per leaf
+    struct LeafParallelModel : public ArenaModel
+    {
+        LeafParallelModel(policy_function_type rollout_policy, chess::side model_side, const Options& options = Options{})
+        : ArenaModel{rollout_policy, model_side, options},
+        pool{std::max(options.n_threads, 1)},
+        worker_policies(std::max(options.n_threads, 1), rollout_policy),
+        worker_playouts(std::max(options.n_threads, 1)),
+        worker_t(std::max(options.n_threads, 1), 0.0)
+        {
+            this->rollout_policy = [this](const chess::position& state, chess::side player_side, node::Playout& playout)
+            {
+                std::uint64_t leaf_seed = playout.generator();
+                pool.run([this, &state, player_side, leaf_seed, &playout](int worker)
+                {
+                    worker_playouts[worker].generator.seed(rng::stream_seed(leaf_seed, worker));
+                    worker_playouts[worker].record_moves = playout.record_moves;
+                    worker_playouts[worker].clear_moves();
+                    worker_t[worker] = worker_policies[worker](state, player_side, worker_playouts[worker]);
+                });
+                for(node::Playout& worker_playout : worker_playouts)
+                {
+                    playout.plies += worker_playout.plies;
+                    worker_playout.plies = 0;
+                    for(int side = 0 ; side < 2 ; ++side) playout.moves[side].insert(playout.moves[side].end(), worker_playout.moves[side].begin(), worker_playout.moves[side].end());
+                }
+                double t{0};
+                for(double worker_score : worker_t) t += worker_score;
+                return t / worker_t.size();
+            };
+        }
+
+        parallel::ThreadPool pool;
+        std::vector<policy_function_type> worker_policies;
+        std::vector<node::Playout> worker_playouts;
+        std::vector<double> worker_t;
+    };
+
+    enum model_type { timed_model, arena_model, tree_parallel_model, root_parallel_model, leaf_parallel_model };
+
+    // Create the arena model with the selection policy selected by the SELECTION config value
+    inline std::unique_ptr<Model> make_arena_model(policy_function_type rollout_policy, chess::side model_side, const Options& options = Options{})
+    {
+        switch(options.selection)
+        {
+            case selection::ucb1_tuned: return std::make_unique<BasicArenaModel<selection::UCB1Tuned>>(rollout_policy, model_side, options);
+            case selection::puct: return std::make_unique<BasicArenaModel<selection::PUCT>>(rollout_policy, model_side, options);
+            case selection::rave: return std::make_unique<BasicArenaModel<selection::RAVE>>(rollout_policy, model_side, options);
+            default: return std::make_unique<ArenaModel>(rollout_policy, model_side, options);
+        }
+    }
+
+    // Create the model selected by the MODEL config value
+    // The timed model dispatches to Policy statically, the other models store it type erased
+    template<node::RolloutPolicy Policy>
+    std::unique_ptr<Model> make_model(int type, Policy rollout_policy, chess::side model_side, const Options& options = Options{})
+    {
+        switch(type)
+        {
+            case arena_model: return make_arena_model(rollout_policy, model_side, options);
+            case tree_parallel_model: return std::make_unique<ParallelModel>(rollout_policy, model_side, options);
+            case root_parallel_model: return std::make_unique<RootParallelModel>(rollout_policy, model_side, options);
+            case leaf_parallel_model: return std::make_unique<LeafParallelModel>(rollout_policy, model_side, options);
+            default: return std::make_unique<BasicTimedModel<Policy>>(rollout_policy, model_side, options.seed, options.memory_limit, options.solver, options.reuse_tree);
+        }
+    }
 }
 
 
@@ -9,6 +9,9 @@
 #include <string>
 #include <sstream>
 #include <algorithm>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
 
 // Retrieve an iterator at a random position
 template<typename Iterator, typename RandomGenerator>
@@ -20,11 +23,12 @@ Iterator random_element(Iterator start, Iterator end, RandomGenerator& generator
 };
 
 // Retrieve a random element between two iterators
+// Every thread draws from its own generator
 template<typename Iterator>
 Iterator random_element(Iterator start, Iterator end)
 {
-    static std::random_device random_device;
-    static std::mt19937 generator(random_device());
+    thread_local std::random_device random_device;
+    thread_local std::mt19937 generator(random_device());
     return random_element(start, end, generator);
 };
 
@@ -65,8 +69,20 @@ struct Timer
     std::chrono::time_point<std::chrono::high_resolution_clock> start_t = std::chrono::high_resolution_clock::now();
 };
 
+// Peak resident set size of the process in kilobytes, 0 where unsupported
+inline long peak_rss_kb()
+{
+#ifndef _WIN32
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+#else
+    return 0;
+#endif
+}
+
 // Simple function to get key(string) val(int) pairs from file to Map
-std::unordered_map<std::string, int> parse_config(std::string filename)
+inline std::unordered_map<std::string, int> parse_config(std::string filename)
 {
     std::unordered_map<std::string, int> dict{};
     std::ifstream is(filename);
@@ -82,4 +98,21 @@ std::unordered_map<std::string, int> parse_config(std::string filename)
     return dict;
 }
 
+// Same as parse_config but keeps fractional values, for the keys that may have them
+inline std::unordered_map<std::string, double> parse_config_decimals(std::string filename)
+{
+    std::unordered_map<std::string, double> dict{};
+    std::ifstream is(filename);
+    std::string line;
+    size_t sep_idx;
+    while(std::getline(is, line))
+    {
+        sep_idx = line.find('=');
+        std::string key{line.substr(0, sep_idx)};
+        std::string val{line.substr(sep_idx+1)};
+        dict.insert({key, std::stod(val)});
+    }
+    return dict;
+}
+
 #endif /* MISC_H */
\ No newline at end of file
@@ -3,165 +3,500 @@
 
 #include <chess/chess.hpp>
 #include <mcts/misc.hpp>
+#include <mcts/instrument.hpp>
+#include <mcts/rng.hpp>
+#include <mcts/selection.hpp>
+#include <array>
+#include <atomic>
+#include <concepts>
+#include <cstring>
+#include <functional>
 #include <vector>
 #include <iterator>
 #include <float.h>
 #include <math.h>
 #include <memory>
+#include <string>
+#include <type_traits>
 
 namespace node
 {
-    using policy_function_type = std::function<double(const chess::position&, chess::side)>;
+    // Check if a and b are the same move by comparing their bytes
+    // A move type with padding bytes falls back to comparing the long algebraic notation
+    inline bool same_move(const chess::move& a, const chess::move& b)
+    {
+        if constexpr (std::has_unique_object_representations_v<chess::move>)
+        {
+            return std::memcmp(&a, &b, sizeof(chess::move)) == 0;
+        }
+        else
+        {
+            return a.to_lan() == b.to_lan();
+        }
+    }
+
+    // Per worker rollout state, the random stream and, while record_moves is set, the moves a rollout played
+    // moves[0] holds the moves of the side to move where the rollout started, moves[1] those of the other side
+    struct Playout
+    {
+        inline void record(const chess::move& move, int ply)
+        {
+            if constexpr (instrument::ENABLED) ++plies;
+            if (record_moves) moves[ply & 1].push_back(move);
+        }
+
+        void clear_moves()
+        {
+            moves[0].clear();
+            moves[1].clear();
+        }
+
+        rng::Xoshiro256 generator{};
+        bool record_moves = false;
+        std::array<std::vector<chess::move>, 2> moves{};
+        std::uint64_t plies = 0;
+    };
+
+    // A rollout policy scores state for player_side, drawing every random number from playout
+    // Policies may keep state such as scratch buffers, they are called by reference and never copied per rollout
+    template<typename Policy>
+    concept RolloutPolicy = requires(Policy& policy, const chess::position& state, chess::side player_side, Playout& playout)
+    {
+        { policy(state, player_side, playout) } -> std::convertible_to<double>;
+    };
+
+    // Type erased rollout policy for models whose policy is picked at run time
+    using policy_function_type = std::function<double(const chess::position&, chess::side, Playout&)>;
+    // Batch rollout policies score every position of a batch of leaves into the matching slot of scores
+    using batch_policy_function_type = std::function<void(const std::vector<chess::position>&, chess::side, Playout&, std::vector<double>&)>;
     
+    // Game theoretic result of a node from the side of the move into it, like its score
+    // With the solver mates and stalemates are proven on their first visit and their ancestors by solve
+    enum proof : std::uint8_t { unproven, proven_win, proven_draw, proven_loss };
+
+    // Live nodes and bytes of one tree, kept up to date by its nodes so another thread may read them during a search
+    // Every tree also counts towards the totals of the process, which tell how many searches fit on a host
+    // Bytes are counted like Node::tree_bytes, nodes with their control blocks, child pointers and move lists
+    struct TreeMemory
+    {
+        // Add nodes and bytes, negative amounts give them back
+        void add(long added_nodes, long added_bytes)
+        {
+            nodes.fetch_add(added_nodes, std::memory_order_relaxed);
+            long now = bytes.fetch_add(added_bytes, std::memory_order_relaxed) + added_bytes;
+            long peak = peak_bytes.load(std::memory_order_relaxed);
+            while (now > peak && !peak_bytes.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {}
+            process_nodes.fetch_add(added_nodes, std::memory_order_relaxed);
+            long process_now = process_bytes.fetch_add(added_bytes, std::memory_order_relaxed) + added_bytes;
+            long process_peak = process_peak_bytes.load(std::memory_order_relaxed);
+            while (process_now > process_peak && !process_peak_bytes.compare_exchange_weak(process_peak, process_now, std::memory_order_relaxed)) {}
+        }
+
+        std::string report() const
+        {
+            std::string report = "-- Memory Report --";
+            report += "\nlive nodes: " + std::to_string(nodes.load(std::memory_order_relaxed));
+            report += "\nlive bytes: " + std::to_string(bytes.load(std::memory_order_relaxed));
+            report += "\npeak bytes: " + std::to_string(peak_bytes.load(std::memory_order_relaxed));
+            report += "\npruned nodes: " + std::to_string(pruned_nodes.load(std::memory_order_relaxed));
+            report += "\nprunes: " + std::to_string(prunes.load(std::memory_order_relaxed));
+            return report;
+        }
+
+        // Live nodes and bytes of every tree of the process, and the most bytes they held at once
+        static std::string process_report()
+        {
+            std::string report = "-- Process Memory Report --";
+            report += "\nlive nodes: " + std::to_string(process_nodes.load(std::memory_order_relaxed));
+            report += "\nlive bytes: " + std::to_string(process_bytes.load(std::memory_order_relaxed));
+            report += "\npeak bytes: " + std::to_string(process_peak_bytes.load(std::memory_order_relaxed));
+            return report;
+        }
+
+        std::atomic<long> nodes{0};
+        std::atomic<long> bytes{0};
+        std::atomic<long> peak_bytes{0};
+        std::atomic<long> pruned_nodes{0};
+        std::atomic<long> prunes{0};
+        static inline std::atomic<long> process_nodes{0};
+        static inline std::atomic<long> process_bytes{0};
+        static inline std::atomic<long> process_peak_bytes{0};
+    };
+
+    // t is the score from the side of the move into the node, so every level selects the child best for its mover
+    // Statistics are relaxed atomics, backpropagation walks the selected path and may run on several threads
+    // Children are created one at a time from the move list kept by expand, mate and stalemate are found on the first visit
     class Node : public std::enable_shared_from_this<Node>
     {
         public:
+            // Nodes from the start node down to a selected node, filled by traverse
+            using Path = std::vector<Node*>;
+
             // Used to create a node that is not a parent node
-            Node(chess::position state, chess::side player_side, bool is_start_node, std::weak_ptr<Node> parent, chess::move move)
+            // A tree with a memory counts its live nodes and bytes there, the memory has to outlive the tree
+            Node(chess::position state, chess::side player_side, bool is_start_node, std::weak_ptr<Node> parent, chess::move move, TreeMemory* memory = nullptr)
                 : state{state},
                 player_side{player_side},
                 is_start_node{is_start_node},
                 parent{parent},
-                move{move}
+                move{move},
+                memory{memory},
+                score_sign{state.get_turn() == player_side ? -1.0 : 1.0}
             {
                 this->children = {};
-                this->t = 0;
-                this->n = 0;
+                if (memory) memory->add(1, node_bytes());
             }
             // Used to create a parent node
-            Node(chess::position state, chess::side player_side) : Node(state, player_side, true, std::weak_ptr<Node>(), chess::move()) {}
-            ~Node() = default;
+            Node(chess::position state, chess::side player_side, TreeMemory* memory = nullptr) : Node(state, player_side, true, std::weak_ptr<Node>(), chess::move(), memory) {}
+            ~Node()
+            {
+                if (memory) memory->add(-1, -static_cast<long>(node_bytes() + owned_bytes()));
+            }
             // Get child nodes
             inline std::vector<std::shared_ptr<Node>> get_children() const
             {
                 return this->children;
             }
 
-            // Perform rollout from state
-            void rollout(policy_function_type rollout_policy)
+            // Perform rollout from state, returns the score for player_side to backpropagate
+            // On the first visit a mate or stalemate is scored as such instead and the node becomes terminal, with prove also proven
+            template<RolloutPolicy Policy>
+            double rollout(Policy& rollout_policy, Playout& playout, bool prove = false)
+            {
+                double score;
+                if (get_n() != 0 || !detect_terminal(score, prove)) score = rollout_policy(state, player_side, playout);
+                add_visit(score);
+                return score;
+            }
+
+            // Add score for player_side and a visit, kept from the side of the move into the node
+            inline void add_visit(double score)
             {
-                t = rollout_policy(state, player_side);
-                n++;
+                t.fetch_add(score_sign * score, std::memory_order_relaxed);
+                n.fetch_add(1, std::memory_order_relaxed);
             }
 
-            // Backpropagate score and visits to parent node
-            void backpropagate()
+            // Add score for player_side and a visit to every node of path above its last one, from the bottom up
+            // Walks the recorded path instead of locking parents, the sign alternates with the side to move
+            static void backpropagate(const Path& path, double score)
             {
-                if (auto p = parent.lock())
+                for (size_t i = path.size() - 1; i-- > 0;)
                 {
-                    p->t += t;
-                    p->n++;
+                    path[i]->add_visit(score);
+                }
+            }
 
-                    if (!p->is_start_node)
-                    {
-                        p->backpropagate();
-                    }
+            // MCTS-Solver backup, prove the nodes of path above its last node with minimax rules as far as they are decided
+            // Called once the last node is proven, returns whether that proved the first node of path
+            static bool solve(const Path& path)
+            {
+                for (size_t i = path.size() - 1; i-- > 0;)
+                {
+                    if (!path[i]->prove()) break;
                 }
+                return path.front()->is_proven();
             }
 
-            // Expand node
-            void expand()
-            {   
-                std::vector<chess::move> available_moves{state.moves()};
-                for (chess::move child_move : available_moves)
+            // Prove this node from its children, returns whether it is proven
+            // One child won by the side to move loses the node for its mover, once every move has a proven child
+            // the node is drawn if one of them is drawn and won otherwise
+            bool prove()
+            {
+                if (is_proven()) return true;
+                if (!expanded || children.empty()) return false;
+                bool decided = !has_untried_moves();
+                bool drawn = false;
+                for (const std::shared_ptr<Node>& child : children)
                 {
-                    chess::position child_state = state.copy_move(child_move); // TODO - Make this optional
-                    std::shared_ptr<Node> new_child = std::make_shared<Node>(child_state, player_side, false, weak_from_this(), child_move);
-                    if (new_child->state.is_checkmate() || new_child->state.is_stalemate())
+                    proof child_proof = child->get_proof();
+                    if (child_proof == proven_win)
                     {
-                        if (new_child->state.is_checkmate())
-                        {
-                            new_child->t = new_child->state.get_turn() == player_side ? -WIN_SCORE : WIN_SCORE;
-                        }
-                        else
-                        {
-                            new_child->t = DRAW_SCORE;
-                        }
-                        new_child->is_terminal_node = true;
-                        new_child->n = 1;
-                        new_child->backpropagate();
+                        set_proof(proven_loss);
+                        return true;
                     }
-                    children.push_back(new_child);
+                    if (child_proof == unproven) decided = false;
+                    if (child_proof == proven_draw) drawn = true;
                 }
+                if (!decided) return false;
+                set_proof(drawn ? proven_draw : proven_win);
+                return true;
             }
 
-            // UCB1 scoring function
-            inline double UCB1() const
+            // Proven result from the side of the move into the node
+            inline proof get_proof() const
             {
-                auto p = parent.lock();
-                if (n == 0 || (p && p->n==0))
-                {
-                    return DBL_MAX;
-                }
-                else
+                return node_proof.load(std::memory_order_relaxed);
+            }
+
+            // Whether the result of the node is known, selection does not enter proven nodes
+            inline bool is_proven() const
+            {
+                return get_proof() != unproven;
+            }
+
+            // Expand node, the legal moves are generated once and kept until widen has made a child of each
+            // A node without moves becomes terminal
+            void expand()
+            {
+                size_t bytes = owned_bytes();
+                moves = state.moves();
+                expanded = true;
+                if (moves.empty()) is_terminal_node = true;
+                account(bytes);
+            }
+
+            // Whether expand has run
+            inline bool is_expanded() const
+            {
+                return expanded;
+            }
+
+            // Whether some moves have no child yet
+            inline bool has_untried_moves() const
+            {
+                return next_move < moves.size();
+            }
+
+            // Create the child of the next untried move and append it to path
+            // The move list is released once every move has a child
+            std::shared_ptr<Node> widen(Path& path)
+            {
+                size_t bytes = owned_bytes();
+                chess::move child_move = moves[next_move++];
+                std::shared_ptr<Node> new_child = std::make_shared<Node>(state.copy_move(child_move), player_side, false, weak_from_this(), child_move, memory);
+                children.push_back(new_child);
+                if (next_move == moves.size())
                 {
-                    double v_bar = t / n;
-                    int N = p ? p->n : 1;
-                    return v_bar + UCB1_CONST*sqrt(log(N) / n);
+                    std::vector<chess::move>{}.swap(moves);
+                    next_move = 0;
                 }
+                account(bytes);
+                path.push_back(new_child.get());
+                return new_child;
             }
 
-            // Determine next node to expand/rollout by traversing tree
-            std::shared_ptr<Node> traverse()
+            // Collapse the children of this node visited less than min_visits times back into leaves
+            // A collapsed node keeps its statistics and is expanded again once selection reaches it
+            // Terminal and proven nodes are kept, as is every node above a proven node, so no proof is lost
+            // Returns the amount of nodes released
+            size_t prune(int min_visits)
             {
-                std::vector<double> UCB1_scores{};
-                for (std::shared_ptr<Node> child : children)
+                size_t released{0};
+                for (const std::shared_ptr<Node>& child : children)
                 {
-                    if (!child->is_terminal_node)
-                        UCB1_scores.push_back(child->UCB1());
+                    if (child->is_terminal_node || child->is_proven()) continue;
+                    if (child->get_n() < min_visits && !child->has_proven_descendant()) released += child->collapse();
+                    else released += child->prune(min_visits);
                 }
-                if (UCB1_scores.size() == 0)
+                return released;
+            }
+
+            // Whether a node anywhere below this node is proven
+            bool has_proven_descendant() const
+            {
+                for (const std::shared_ptr<Node>& child : children)
                 {
-                    is_terminal_node = true;
-                    return parent.lock() ? parent.lock() : shared_from_this();
+                    if (child->is_proven() || child->has_proven_descendant()) return true;
                 }
+                return false;
+            }
 
-                std::shared_ptr<Node> best_child = get_max_element<std::shared_ptr<Node>>(children.begin(), UCB1_scores.begin(), UCB1_scores.end());
+            // Release the children and move list of this node, which becomes an unexpanded leaf
+            // Returns the amount of nodes released
+            size_t collapse()
+            {
+                size_t released{0};
+                for (const std::shared_ptr<Node>& child : children) released += 1 + child->count_descendants();
+                size_t bytes = owned_bytes();
+                std::vector<std::shared_ptr<Node>>{}.swap(children);
+                std::vector<chess::move>{}.swap(moves);
+                next_move = 0;
+                expanded = false;
+                account(bytes);
+                if (memory) memory->pruned_nodes.fetch_add(static_cast<long>(released), std::memory_order_relaxed);
+                return released;
+            }
+
+            // Amount of nodes below this node
+            size_t count_descendants() const
+            {
+                size_t count{0};
+                for (const std::shared_ptr<Node>& child : children) count += 1 + child->count_descendants();
+                return count;
+            }
+
+            // UCB1 scoring function
+            inline double UCB1() const
+            {
+                auto p = parent.lock();
+                int N = p ? p->get_n() : 1;
+                return UCB1(N, log(N));
+            }
 
-                if (best_child->children.size() > 0)
+            // UCB1 score given the visits of the parent and their log, which callers take once for all children
+            inline double UCB1(int parent_n, double log_parent_n) const
+            {
+                int visits = get_n();
+                if (visits == 0 || parent_n == 0)
                 {
-                    return best_child->children.front()->traverse();
+                    return DBL_MAX;
                 }
-                else
+                return get_t() / visits + UCB1_CONST*sqrt(log_parent_n / visits);
+            }
+
+            // Determine next node to expand/rollout by traversing tree
+            // path holds this node on entry and ends with the returned node on exit
+            // A node with untried moves gets its next child, which UCB1 would pick first as it has no visits
+            // Without grow no child is created, selection stays among the existing children
+            // Terminal and proven children are not selected, nodes whose children are all blocked become terminal and selection restarts
+            // Child statistics are gathered into a per thread scratch array, so selection does not allocate
+            std::shared_ptr<Node> traverse(Path& path, bool grow = true)
+            {
+                thread_local selection::ChildStats stats{};
+                Node* current = this;
+                while (true)
                 {
-                    return best_child;
+                    if (grow && current->has_untried_moves()) return current->widen(path);
+                    if (current->children.empty()) return current->shared_from_this();
+                    const std::vector<std::shared_ptr<Node>>& current_children = current->children;
+                    stats.resize(current_children.size());
+                    for (size_t i = 0; i < current_children.size(); ++i)
+                    {
+                        stats.t[i] = current_children[i]->get_t();
+                        stats.n[i] = current_children[i]->get_n();
+                        stats.blocked[i] = current_children[i]->is_terminal_node || current_children[i]->is_proven();
+                    }
+                    size_t best = selection::best_ucb1(stats, current->get_n(), UCB1_CONST);
+                    if (best == current_children.size())
+                    {
+                        if (current->has_untried_moves()) return current->shared_from_this();
+                        current->is_terminal_node = true;
+                        if (current == this) return shared_from_this();
+                        path.assign(1, this);
+                        current = this;
+                        continue;
+                    }
+                    current = current_children[best].get();
+                    path.push_back(current);
                 }
             }
 
-            // Retrieve the best child node based on UCB1 score
+            // Retrieve the best child node based on accumulated score
+            // With by_proof, for searches with the solver, a proven win goes before every other child and a proven loss after them
             // Can be useful if we want to keep the tree from the previous iterations
-            std::shared_ptr<Node> best_child() const
+            std::shared_ptr<Node> best_child(bool by_proof = false) const
             {
-                std::vector<double> winrates{};
-                for (std::shared_ptr<Node> child : children)
+                size_t best = 0;
+                for (size_t i = 1; i < children.size(); ++i)
                 {
-                    winrates.push_back(child->t);
+                    int rank = by_proof ? proof_rank(children[i]->get_proof()) : 1;
+                    int best_rank = by_proof ? proof_rank(children[best]->get_proof()) : 1;
+                    if (rank > best_rank || (rank == best_rank && children[i]->get_t() > children[best]->get_t())) best = i;
                 }
-                return get_max_element<std::shared_ptr<Node>>(children.begin(), winrates.begin(), winrates.end());
+                return children[best];
             }
             // Get the move that gives the best child
             // Useful for baseline mcts algorithm
-            chess::move best_move() const
+            // Before any child exists it is the first legal move, by_proof ranks the children as best_child does
+            chess::move best_move(bool by_proof = false) const
             {
-                return best_child()->move;
+                if (children.empty() && has_untried_moves()) return moves[next_move];
+                return best_child(by_proof)->move;
+            }
+
+            // Line of at most max_length moves, starting with best_move(by_proof) and following the most visited child below it
+            std::vector<chess::move> principal_variation(bool by_proof = false, size_t max_length = 32) const
+            {
+                std::vector<chess::move> line{};
+                const Node* current = this;
+                while (line.size() < max_length && !current->children.empty())
+                {
+                    std::shared_ptr<Node> best = current == this ? best_child(by_proof) : current->children.front();
+                    for (const std::shared_ptr<Node>& child : current->children)
+                    {
+                        if (current != this && child->get_n() > best->get_n()) best = child;
+                    }
+                    if (best->get_n() == 0) break;
+                    line.push_back(best->move);
+                    current = best.get();
+                }
+                return line;
+            }
+
+            // Child reached by move, nullptr if it has none yet
+            std::shared_ptr<Node> find_child(const chess::move& move) const
+            {
+                for (const std::shared_ptr<Node>& child : children)
+                {
+                    if (same_move(child->move, move)) return child;
+                }
+                return nullptr;
+            }
+
+            // Detach this node from its parent to make it the start node of its own tree
+            // Whoever holds the old start node may release it afterwards, this subtree is kept
+            void make_root()
+            {
+                parent.reset();
+                is_start_node = true;
             }
 
             // Get state
-            chess::position get_state() const
+            const chess::position& get_state() const
             {
                 return state;
             }
 
-            // Check if current state is a terminal state
+            // Get the move into this node
+            const chess::move& get_move() const
+            {
+                return move;
+            }
+
+            // Check if the node is known to be terminal, by expand or on its first visit
             bool is_over() const
             {
-                return is_terminal_node || state.is_checkmate() || state.is_stalemate();
+                return is_terminal_node;
+            }
+
+            // Bytes held by the subtree of this node, its nodes, child pointers and move lists
+            size_t tree_bytes() const
+            {
+                size_t bytes = node_bytes() + owned_bytes();
+                for (const std::shared_ptr<Node>& child : children) bytes += child->tree_bytes();
+                return bytes;
             }
 
             // Get amount of vists
             int get_n() const
             {
-                return n;
+                return n.load(std::memory_order_relaxed);
+            }
+
+            // Get accumulated score
+            double get_t() const
+            {
+                return t.load(std::memory_order_relaxed);
+            }
+
+            // Get how far the best child is ahead of the second best by score
+            double leader_gap() const
+            {
+                double best = -DBL_MAX, second = -DBL_MAX;
+                for (std::shared_ptr<Node> child : children)
+                {
+                    double child_t = child->get_t();
+                    if (child_t > best)
+                    {
+                        second = best;
+                        best = child_t;
+                    }
+                    else if (child_t > second)
+                    {
+                        second = child_t;
+                    }
+                }
+                return children.size() > 1 ? best - second : DBL_MAX;
             }
 
             // Print the main node and its children
@@ -181,30 +516,80 @@ namespace node
                 return tree;
             }
 
-            static double WIN_SCORE;
-            static double DRAW_SCORE;
-            static double UCB1_CONST;
+            static inline double WIN_SCORE = 1.0;
+            static inline double DRAW_SCORE = 0.0;
+            static inline double UCB1_CONST = 2.0;
+
+            // Bytes of a node and the control block of two counters make_shared puts next to it
+            static constexpr size_t node_bytes()
+            {
+                return sizeof(Node) + 2 * sizeof(long);
+            }
 
         protected:
+            // Bytes of the child pointers and move list of this node
+            size_t owned_bytes() const
+            {
+                return children.capacity() * sizeof(std::shared_ptr<Node>) + moves.capacity() * sizeof(chess::move);
+            }
+
+            // Count the change of owned_bytes since it was before_bytes in the tree memory
+            inline void account(size_t before_bytes)
+            {
+                if (memory) memory->add(0, static_cast<long>(owned_bytes()) - static_cast<long>(before_bytes));
+            }
+
+            // Mate or stalemate score for player_side, false if the position goes on
+            // With prove a mate is a proven win for the side that gave it and a stalemate a proven draw
+            bool detect_terminal(double& score, bool prove)
+            {
+                if (state.is_checkmate())
+                {
+                    score = state.get_turn() == player_side ? -WIN_SCORE : WIN_SCORE;
+                    if (prove) set_proof(proven_win);
+                }
+                else if (state.is_stalemate())
+                {
+                    score = DRAW_SCORE;
+                    if (prove) set_proof(proven_draw);
+                }
+                else return false;
+                is_terminal_node = true;
+                return true;
+            }
+
+            inline void set_proof(proof result)
+            {
+                node_proof.store(result, std::memory_order_relaxed);
+            }
+
+            // Order of children by proof for best_child
+            static int proof_rank(proof result)
+            {
+                return result == proven_win ? 2 : result == proven_loss ? 0 : 1;
+            }
+
             chess::position state;
             chess::side player_side;
             chess::move move;
             bool is_start_node;
             bool is_terminal_node = false;
             std::weak_ptr<Node> parent;
+            TreeMemory* memory;
             std::vector<std::shared_ptr<Node>> children;
-            double t;
-            int n;
+            std::vector<chess::move> moves{};
+            size_t next_move = 0;
+            bool expanded = false;
+            double score_sign;
+            std::atomic<double> t{0};
+            std::atomic<int> n{0};
+            std::atomic<proof> node_proof{unproven};
     };
-    
-    double Node::WIN_SCORE = 1.0;
-    double Node::DRAW_SCORE = 0.0;
-    double Node::UCB1_CONST = 2.0;
 
     // Initialize node library 
     // Sets reward scores
     // Not necessary unless modifying scores is desired
-    void init(double win_score, double draw_score, double UCB1_const) {
+    inline void init(double win_score, double draw_score, double UCB1_const) {
         Node::WIN_SCORE = win_score;
         Node::DRAW_SCORE = draw_score;
         Node::UCB1_CONST = UCB1_const;
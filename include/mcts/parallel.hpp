@@ -0,0 +1,227 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threading helpers shared by the parallel models
+namespace parallel
+{
+    // Fork-join pool, run() hands the same task to every worker and waits for all of them
+    // The calling thread acts as worker 0, so n_threads - 1 threads are started
+    class ThreadPool
+    {
+        public:
+            ThreadPool(int n_threads)
+            {
+                for (int worker = 1; worker < n_threads; ++worker)
+                {
+                    workers.emplace_back([this, worker]() { work(worker); });
+                }
+            }
+            ThreadPool(const ThreadPool&) = delete;
+            ThreadPool& operator=(const ThreadPool&) = delete;
+            ~ThreadPool()
+            {
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    stopping = true;
+                }
+                start_cv.notify_all();
+                for (std::thread& worker : workers) worker.join();
+            }
+
+            // Call task(worker) once on every worker
+            void run(const std::function<void(int)>& task)
+            {
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    current_task = &task;
+                    pending = static_cast<int>(workers.size());
+                    ++generation;
+                }
+                start_cv.notify_all();
+                task(0);
+                std::unique_lock<std::mutex> lock{mutex};
+                done_cv.wait(lock, [this]() { return pending == 0; });
+            }
+
+            // Amount of workers including the calling thread
+            int size() const
+            {
+                return static_cast<int>(workers.size()) + 1;
+            }
+
+        private:
+            void work(int worker)
+            {
+                size_t seen_generation = 0;
+                while (true)
+                {
+                    const std::function<void(int)>* task;
+                    {
+                        std::unique_lock<std::mutex> lock{mutex};
+                        start_cv.wait(lock, [this, seen_generation]() { return stopping || generation != seen_generation; });
+                        if (stopping) return;
+                        seen_generation = generation;
+                        task = current_task;
+                    }
+                    (*task)(worker);
+                    {
+                        std::lock_guard<std::mutex> lock{mutex};
+                        --pending;
+                    }
+                    done_cv.notify_one();
+                }
+            }
+
+            std::vector<std::thread> workers{};
+            std::mutex mutex{};
+            std::condition_variable start_cv{};
+            std::condition_variable done_cv{};
+            const std::function<void(int)>* current_task = nullptr;
+            size_t generation = 0;
+            int pending = 0;
+            bool stopping = false;
+    };
+
+    // Pool for independent tasks of uneven length, e.g. whole games
+    // Every worker owns a deque, takes its newest task first and steals the oldest task of another worker when it runs dry
+    // submit() deals tasks over the deques in turn, wait() returns once every submitted task has run
+    class WorkStealingPool
+    {
+        public:
+            WorkStealingPool(int n_threads)
+            {
+                for (int worker = 0; worker < std::max(n_threads, 1); ++worker) queues.push_back(std::make_unique<Queue>());
+                for (int worker = 0; worker < std::max(n_threads, 1); ++worker)
+                {
+                    workers.emplace_back([this, worker]() { work(worker); });
+                }
+            }
+            WorkStealingPool(const WorkStealingPool&) = delete;
+            WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+            ~WorkStealingPool()
+            {
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    stopping = true;
+                }
+                work_cv.notify_all();
+                for (std::thread& worker : workers) worker.join();
+            }
+
+            // The counters are raised before the task is published, so a worker that takes it at once cannot take them below zero
+            // Lock order is mutex before a queue mutex, workers never hold a queue mutex while taking mutex
+            void submit(std::function<void()> task)
+            {
+                Queue& queue = *queues[next_queue++ % queues.size()];
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    ++queued;
+                    ++pending;
+                    std::lock_guard<std::mutex> queue_lock{queue.mutex};
+                    queue.tasks.push_back(std::move(task));
+                }
+                work_cv.notify_one();
+            }
+
+            // Wait until every submitted task has run
+            void wait()
+            {
+                std::unique_lock<std::mutex> lock{mutex};
+                done_cv.wait(lock, [this]() { return pending == 0; });
+            }
+
+            int size() const
+            {
+                return static_cast<int>(workers.size());
+            }
+
+            // Tasks taken from the deque of another worker
+            size_t steals() const
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+                return stolen;
+            }
+
+        private:
+            struct Queue
+            {
+                std::mutex mutex{};
+                std::deque<std::function<void()>> tasks{};
+            };
+
+            // Take the newest task of worker or the oldest task of another worker
+            bool take(int worker, std::function<void()>& task, bool& was_stolen)
+            {
+                for (size_t i = 0; i < queues.size(); ++i)
+                {
+                    Queue& queue = *queues[(worker + i) % queues.size()];
+                    std::lock_guard<std::mutex> lock{queue.mutex};
+                    if (queue.tasks.empty()) continue;
+                    if (i == 0)
+                    {
+                        task = std::move(queue.tasks.back());
+                        queue.tasks.pop_back();
+                    }
+                    else
+                    {
+                        task = std::move(queue.tasks.front());
+                        queue.tasks.pop_front();
+                    }
+                    was_stolen = i != 0;
+                    return true;
+                }
+                return false;
+            }
+
+            void work(int worker)
+            {
+                while (true)
+                {
+                    std::function<void()> task;
+                    bool was_stolen = false;
+                    if (take(worker, task, was_stolen))
+                    {
+                        {
+                            std::lock_guard<std::mutex> lock{mutex};
+                            --queued;
+                            if (was_stolen) ++stolen;
+                        }
+                        task();
+                        bool done;
+                        {
+                            std::lock_guard<std::mutex> lock{mutex};
+                            done = --pending == 0;
+                        }
+                        if (done) done_cv.notify_all();
+                        continue;
+                    }
+                    std::unique_lock<std::mutex> lock{mutex};
+                    work_cv.wait(lock, [this]() { return stopping || queued > 0; });
+                    if (stopping && queued == 0) return;
+                }
+            }
+
+            std::vector<std::unique_ptr<Queue>> queues{};
+            std::vector<std::thread> workers{};
+            mutable std::mutex mutex{};
+            std::condition_variable work_cv{};
+            std::condition_variable done_cv{};
+            std::atomic<size_t> next_queue{0};
+            size_t queued = 0;
+            size_t pending = 0;
+            size_t stolen = 0;
+            bool stopping = false;
+    };
+}
+
+#endif /* PARALLEL_H */
\ No newline at end of file
@@ -3,18 +3,46 @@
 
 #include <functional>
 #include <mcts/node.hpp>
+#include <mcts/rng.hpp>
+#include <mcts/eval.hpp>
 #include <chess/chess.hpp>
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstdint>
 #include <iostream>
+#include <vector>
 
 // Stores some different policies that can be used by Node
 namespace policy
 {
+    // Most legal moves of a chess position, 218, rounded up
+    constexpr size_t MAX_MOVES = 256;
+
+    // Legal moves of a position as libchess hands them out
+    struct MoveList
+    {
+        std::vector<chess::move> moves{};
+        std::uint32_t size = 0;
+    };
+
+    // Replace the moves of list with the legal moves of state
+    // The only place rollouts generate moves. libchess returns a new vector per call and offers no way to build
+    // a chess::move from squares, so moves cannot be generated into a buffer of our own and every ply costs
+    // one heap allocation. The vector is moved into list rather than copied
+    inline void generate_moves(const chess::position& state, MoveList& list)
+    {
+        list.moves = state.moves();
+        list.size = static_cast<std::uint32_t>(list.moves.size());
+    }
+
     // Rollout policies
     namespace rollout
     {
         // Random rollout policy
         // n_iter denotes amount of simulated games to play from start state
-        double random_rollout(const chess::position &state, chess::side player_side, std::mt19937 &generator, int n_iter=10)
+        // Played moves are recorded in playout when it asks for them
+        inline double random_rollout(const chess::position &state, chess::side player_side, node::Playout &playout, int n_iter=10)
         {
             double accumulated_t{0};
             for (int i = 0; i < n_iter; ++i)
@@ -22,10 +50,12 @@ namespace policy
                 chess::position rollout_state = state;
                 // by default, do random rollouts
                 short uneventful_timer = 0;
+                int ply = 0;
                 while (!rollout_state.is_checkmate() && !rollout_state.is_stalemate() && uneventful_timer < 50)
                 {
                     std::vector<chess::move> available_moves{rollout_state.moves()};
-                    chess::move random_choice = *random_element(std::begin(available_moves), std::end(available_moves), generator);
+                    chess::move random_choice = *random_element(std::begin(available_moves), std::end(available_moves), playout.generator);
+                    playout.record(random_choice, ply++);
                     chess::undo undo = rollout_state.make_move(random_choice);
                     uneventful_timer = undo.capture != chess::piece::piece_none ? 0 : uneventful_timer + 1;
                 }
@@ -44,19 +74,255 @@ namespace policy
             return accumulated_t / n_iter;
         };
 
+        // Random rollout policy that generates moves once per ply, see generate_moves
+        // An empty move list ends the game, so mate and stalemate need no extra move generation
+        // The position the 50 move counter stops at is still checked for mate
+        // Moves are drawn with xoshiro256** and unbiased bounded sampling
+        // Played moves are recorded in playout when it asks for them
+        inline double fast_rollout(const chess::position &state, chess::side player_side, node::Playout &playout, int n_iter=10)
+        {
+            double accumulated_t{0};
+            MoveList available_moves;
+            for (int i = 0; i < n_iter; ++i)
+            {
+                chess::position rollout_state = state;
+                short uneventful_timer = 0;
+                int ply = 0;
+                while (true)
+                {
+                    generate_moves(rollout_state, available_moves);
+                    if (available_moves.size == 0 || uneventful_timer >= 50) break;
+                    chess::move random_choice = available_moves.moves[playout.generator.bounded(available_moves.size)];
+                    playout.record(random_choice, ply++);
+                    chess::undo undo = rollout_state.make_move(random_choice);
+                    uneventful_timer = undo.capture != chess::piece::piece_none ? 0 : uneventful_timer + 1;
+                }
+
+                bool is_player_turn = rollout_state.get_turn() == player_side;
+                if (available_moves.size == 0 && rollout_state.is_checkmate())
+                {
+                    accumulated_t += is_player_turn ? -node::Node::WIN_SCORE : node::Node::WIN_SCORE;
+                }
+                else
+                {
+                    accumulated_t += node::Node::DRAW_SCORE;
+                }
+            }
+
+            return accumulated_t / n_iter;
+        };
+
+        // random_rollout as a policy object
+        struct RandomRollout
+        {
+            inline double operator()(const chess::position &state, chess::side player_side, node::Playout &playout)
+            {
+                return random_rollout(state, player_side, playout, n_iter);
+            }
+
+            int n_iter = 10;
+        };
+
+        // fast_rollout as a policy object, statically dispatched when a model is templated on it
+        struct FastRollout
+        {
+            inline double operator()(const chess::position &state, chess::side player_side, node::Playout &playout)
+            {
+                return fast_rollout(state, player_side, playout, n_iter);
+            }
+
+            int n_iter = 10;
+        };
+
+        static_assert(node::RolloutPolicy<RandomRollout> && node::RolloutPolicy<FastRollout>);
+
+        // Weights of heuristic_rollout
+        // capture is the sampling weight of a capture relative to a quiet move, 1 samples uniformly
+        // mvv_lva scales it by the MVV-LVA rank of the capture, pawn takes pawn keeps the capture weight
+        // cutoff_depth ends a playout after that many plies and scores it by eval::Board, 0 plays to the end
+        // eval_scale is the centipawn score that counts as three quarters of a win
+        struct HeuristicWeights
+        {
+            double capture = 4.0;
+            bool mvv_lva = true;
+            int cutoff_depth = 0;
+            double eval_scale = 400.0;
+        };
+
+        // Sampling weight of move on board
+        inline double move_weight(const eval::Board& board, const eval::Move& move, const HeuristicWeights& weights)
+        {
+            int victim = std::abs(board.victim(move));
+            if (victim == eval::empty) return 1.0;
+            if (!weights.mvv_lva) return weights.capture;
+            int attacker = std::abs(board.mover(move));
+            return weights.capture * (6 * victim - attacker + 1) / 6.0;
+        }
+
+        // Rollout policy that samples captures more often and may cut the playout off early
+        // Moves are weighted by move_weight on a mailbox board that follows the game, see eval::Board
+        // A cut off playout is scored by the material and piece-square score of the board, kept up to date move by move
+        // Throws std::invalid_argument if the board diagram or a move cannot be read, see eval.hpp
+        // Played moves are recorded in playout when it asks for them
+        inline double heuristic_rollout(const chess::position &state, chess::side player_side, node::Playout &playout, const HeuristicWeights& weights, int n_iter=10)
+        {
+            double accumulated_t{0};
+            MoveList available_moves;
+            std::array<eval::Move, MAX_MOVES> parsed_moves;
+            std::array<double, MAX_MOVES> cumulative_weights;
+            const eval::Board start_board{state};
+            for (int i = 0; i < n_iter; ++i)
+            {
+                chess::position rollout_state = state;
+                eval::Board board = start_board;
+                short uneventful_timer = 0;
+                int ply = 0;
+                bool cut_off = false;
+                while (true)
+                {
+                    if (weights.cutoff_depth > 0 && ply >= weights.cutoff_depth)
+                    {
+                        cut_off = true;
+                        break;
+                    }
+                    generate_moves(rollout_state, available_moves);
+                    if (available_moves.size == 0 || uneventful_timer >= 50) break;
+
+                    double total = 0.0;
+                    for (std::uint32_t j = 0; j < available_moves.size; ++j)
+                    {
+                        parsed_moves[j] = eval::parse(available_moves.moves[j]);
+                        total += move_weight(board, parsed_moves[j], weights);
+                        cumulative_weights[j] = total;
+                    }
+                    double target = static_cast<double>(playout.generator() >> 11) * 0x1.0p-53 * total;
+                    std::uint32_t choice = static_cast<std::uint32_t>(std::upper_bound(cumulative_weights.begin(), cumulative_weights.begin() + available_moves.size, target) - cumulative_weights.begin());
+                    choice = std::min(choice, available_moves.size - 1);
+                    board.play(parsed_moves[choice]);
+
+                    chess::move heuristic_choice = available_moves.moves[choice];
+                    playout.record(heuristic_choice, ply++);
+                    chess::undo undo = rollout_state.make_move(heuristic_choice);
+                    uneventful_timer = undo.capture != chess::piece::piece_none ? 0 : uneventful_timer + 1;
+                }
+
+                bool is_player_turn = rollout_state.get_turn() == player_side;
+                if (cut_off)
+                {
+                    accumulated_t += eval::to_rollout_score(board.score, player_side, node::Node::WIN_SCORE, weights.eval_scale);
+                }
+                else if (!cut_off && available_moves.size == 0 && rollout_state.is_checkmate())
+                {
+                    accumulated_t += is_player_turn ? -node::Node::WIN_SCORE : node::Node::WIN_SCORE;
+                }
+                else
+                {
+                    accumulated_t += node::Node::DRAW_SCORE;
+                }
+            }
+
+            return accumulated_t / n_iter;
+        };
+
+        // heuristic_rollout as a policy object
+        struct HeuristicRollout
+        {
+            inline double operator()(const chess::position &state, chess::side player_side, node::Playout &playout)
+            {
+                return heuristic_rollout(state, player_side, playout, weights, n_iter);
+            }
+
+            int n_iter = 10;
+            HeuristicWeights weights{};
+        };
+
+        static_assert(node::RolloutPolicy<HeuristicRollout>);
+
+        // Batched random rollout policy, plays n_iter games from every leaf of a batch in lockstep
+        // Games are kept as structure of arrays and every step advances each running game by one ply
+        // The n_iter games of a leaf start from the same position, so their first ply shares one move generation
+        // After that libchess generates moves one position at a time, which no batch layout can vectorise
+        // Finished games leave the active list, so a step only touches games that still run
+        // Every game is checked for mate once at the end, including those stopped by the 50 move counter
+        // The storage is kept between calls, a copy of the policy per thread avoids sharing it
+        // Moves are not recorded, the games of a batch start from different leaves
+        class BatchRollout
+        {
+            public:
+                BatchRollout(int n_iter=10)
+                    : n_iter{n_iter}
+                {}
+
+                void operator()(const std::vector<chess::position>& leaves, chess::side player_side, node::Playout& playout, std::vector<double>& scores)
+                {
+                    states.clear();
+                    uneventful_timers.assign(leaves.size() * n_iter, 0);
+                    active.clear();
+                    for (const chess::position& leaf : leaves)
+                    {
+                        generate_moves(leaf, available_moves);
+                        for (int i = 0; i < n_iter; ++i)
+                        {
+                            std::uint32_t game = static_cast<std::uint32_t>(states.size());
+                            states.push_back(leaf);
+                            if (available_moves.size == 0) continue;
+                            step(game, available_moves.moves[playout.generator.bounded(available_moves.size)], playout);
+                        }
+                    }
+
+                    while (!active.empty())
+                    {
+                        size_t kept = 0;
+                        for (std::uint32_t game : active)
+                        {
+                            generate_moves(states[game], available_moves);
+                            if (available_moves.size == 0) continue;
+                            chess::undo undo = states[game].make_move(available_moves.moves[playout.generator.bounded(available_moves.size)]);
+                            if constexpr (instrument::ENABLED) ++playout.plies;
+                            uneventful_timers[game] = undo.capture != chess::piece::piece_none ? 0 : uneventful_timers[game] + 1;
+                            if (uneventful_timers[game] < 50) active[kept++] = game;
+                        }
+                        active.resize(kept);
+                    }
+
+                    scores.assign(leaves.size(), 0.0);
+                    for (size_t game = 0; game < states.size(); ++game)
+                    {
+                        double t = node::Node::DRAW_SCORE;
+                        if (states[game].is_checkmate())
+                        {
+                            t = states[game].get_turn() == player_side ? -node::Node::WIN_SCORE : node::Node::WIN_SCORE;
+                        }
+                        scores[game / n_iter] += t;
+                    }
+                    for (double& t : scores) t /= n_iter;
+                }
+
+            private:
+                // Play move in game, which stays active unless the 50 move counter ends it
+                inline void step(std::uint32_t game, const chess::move& move, node::Playout& playout)
+                {
+                    chess::undo undo = states[game].make_move(move);
+                    if constexpr (instrument::ENABLED) ++playout.plies;
+                    uneventful_timers[game] = undo.capture != chess::piece::piece_none ? 0 : uneventful_timers[game] + 1;
+                    if (uneventful_timers[game] < 50) active.push_back(game);
+                }
+
+                int n_iter;
+                std::vector<chess::position> states{};
+                std::vector<short> uneventful_timers{};
+                std::vector<std::uint32_t> active{};
+                MoveList available_moves{};
+        };
+
         // Bad rollout for demonstration purposes only
-        double bad_rollout(chess::position state, chess::side player_side)
+        inline double bad_rollout(chess::position state, chess::side player_side, node::Playout &playout)
         {
             return 0;
         };
     }
 
-    // // Traversal policies
-    //TODO: Modular traveral policies
-    // namespace traverse
-    // {
-    //     node::Node *UCB1_traverse(node::Node* start_node);
-    // }
+    // Traversal policies live in selection.hpp as template parameters of arena::BasicTree
 
     //TODO: Modular expansion policies
 }
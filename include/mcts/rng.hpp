@@ -0,0 +1,93 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+#include <limits>
+
+// Small and fast random number generation for rollouts
+namespace rng
+{
+    // SplitMix64, used to expand a single seed into generator state
+    inline std::uint64_t splitmix64(std::uint64_t& seed)
+    {
+        std::uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Seed of stream number stream derived from seed
+    // Searches and workers each draw from their own stream, so results do not depend on thread timing
+    inline std::uint64_t stream_seed(std::uint64_t seed, std::uint64_t stream)
+    {
+        std::uint64_t state = seed ^ (stream * 0xD1B54A32D192ED03ull);
+        return splitmix64(state);
+    }
+
+    // xoshiro256** generator, satisfies UniformRandomBitGenerator
+    class Xoshiro256
+    {
+        public:
+            using result_type = std::uint64_t;
+
+            Xoshiro256(std::uint64_t seed = 0)
+            {
+                this->seed(seed);
+            }
+
+            void seed(std::uint64_t seed)
+            {
+                for (std::uint64_t& word : s) word = splitmix64(seed);
+            }
+
+            inline result_type operator()()
+            {
+                const std::uint64_t result = rotl(s[1] * 5, 7) * 9;
+                const std::uint64_t t = s[1] << 17;
+                s[2] ^= s[0];
+                s[3] ^= s[1];
+                s[1] ^= s[2];
+                s[0] ^= s[3];
+                s[2] ^= t;
+                s[3] = rotl(s[3], 45);
+                return result;
+            }
+
+            // Unbiased integer in [0, range) by Lemire's multiply and reject method
+            inline std::uint32_t bounded(std::uint32_t range)
+            {
+                std::uint64_t product = static_cast<std::uint64_t>(static_cast<std::uint32_t>((*this)() >> 32)) * range;
+                std::uint32_t low = static_cast<std::uint32_t>(product);
+                if (low < range)
+                {
+                    std::uint32_t threshold = -range % range;
+                    while (low < threshold)
+                    {
+                        product = static_cast<std::uint64_t>(static_cast<std::uint32_t>((*this)() >> 32)) * range;
+                        low = static_cast<std::uint32_t>(product);
+                    }
+                }
+                return static_cast<std::uint32_t>(product >> 32);
+            }
+
+            static constexpr result_type min()
+            {
+                return 0;
+            }
+
+            static constexpr result_type max()
+            {
+                return std::numeric_limits<result_type>::max();
+            }
+
+        private:
+            static inline std::uint64_t rotl(std::uint64_t x, int k)
+            {
+                return (x << k) | (x >> (64 - k));
+            }
+
+            std::uint64_t s[4];
+    };
+}
+
+#endif /* RNG_H */
\ No newline at end of file
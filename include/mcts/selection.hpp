@@ -0,0 +1,344 @@
+#ifndef SELECTION_H
+#define SELECTION_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Child selection shared by node::Node and arena::Tree
+// The selection policies are template parameters of arena::BasicTree, so their formula is inlined into traverse
+namespace selection
+{
+    // Statistics of the children of one node as structure of arrays
+    // extra_t and extra_n hold what a policy adds to t and n, e.g. a prior or AMAF statistics
+    // Filled once per visit, the arrays keep their capacity so selection stops allocating after warm up
+    struct ChildStats
+    {
+        void resize(size_t count)
+        {
+            t.resize(count);
+            n.resize(count);
+            extra_t.resize(count);
+            extra_n.resize(count);
+            blocked.resize(count);
+            scores.resize(count);
+        }
+
+        size_t size() const
+        {
+            return t.size();
+        }
+
+        std::vector<double> t{};
+        std::vector<double> n{};
+        std::vector<double> extra_t{};
+        std::vector<double> extra_n{};
+        std::vector<std::uint8_t> blocked{};
+        std::vector<double> scores{};
+    };
+
+    // Constants the policies score with, max_score is the largest score of one rollout
+    struct Params
+    {
+        double exploration;
+        double max_score;
+    };
+
+    constexpr double MAX_SCORE = std::numeric_limits<double>::max();
+    constexpr double BLOCKED_SCORE = -std::numeric_limits<double>::infinity();
+
+    // Index of the highest of the first count scores, count if every child is blocked
+    inline size_t argmax(const double* scores, size_t count)
+    {
+        size_t best = count;
+        double best_score = BLOCKED_SCORE;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (scores[i] > best_score)
+            {
+                best = i;
+                best_score = scores[i];
+            }
+        }
+        return best;
+    }
+
+    // Index of the child with the highest UCB1 score, stats.size() if every child is blocked
+    // log N of the parent is taken once, children without visits score highest
+    // Scoring is one branch free pass over the arrays, vectorised when sqrt may skip errno (-fno-math-errno -fno-trapping-math)
+    inline size_t best_ucb1(ChildStats& stats, int parent_n, double exploration)
+    {
+        const size_t count = stats.size();
+        const double* t = stats.t.data();
+        const double* n = stats.n.data();
+        const std::uint8_t* blocked = stats.blocked.data();
+        double* scores = stats.scores.data();
+        const double unvisited = parent_n == 0 ? 0.0 : 1.0;
+        const double log_parent_n = parent_n > 0 ? std::log(static_cast<double>(parent_n)) : 0.0;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            double visits = std::max(n[i], 1.0);
+            double score = t[i] / visits + exploration * std::sqrt(log_parent_n / visits);
+            score = n[i] * unvisited > 0.0 ? score : MAX_SCORE;
+            scores[i] = blocked[i] ? BLOCKED_SCORE : score;
+        }
+        return argmax(scores, count);
+    }
+
+    // A selection policy provides
+    //   Stats                          per node statistics next to t and n, an empty struct takes no space
+    //   uses_amaf                      whether the tree records all-moves-as-first statistics for it
+    //   on_expand(stats, capture)      called once for every new child
+    //   on_visit(stats, t)             called for every score added to a node
+    //   on_amaf(stats, t)              called for every AMAF score added to a child
+    //   load(children, i, stats)       copy the extra statistics of child i into children
+    //   pending(children, i, loss, m)  count loss pending virtual losses of child i, each a visit scoring -m, in its extra statistics
+    //   copy(target, source)           copy the statistics when a subtree is kept
+    //   save(stats, values)            write the statistics into two doubles of a tree snapshot
+    //   restore(stats, values)         read them back from a snapshot
+    //   best(children, parent_n, p)    index of the child to select, children.size() if all are blocked
+
+    // UCB1, mean score plus exploration * sqrt(log N / n)
+    struct UCB1
+    {
+        struct Stats {};
+
+        static constexpr bool uses_amaf = false;
+
+        static inline void on_expand(Stats&, bool) {}
+        static inline void on_visit(Stats&, double) {}
+        static inline void on_amaf(Stats&, double) {}
+        static inline void load(ChildStats&, size_t, const Stats&) {}
+        static inline void pending(ChildStats&, size_t, int, double) {}
+        static inline void copy(Stats&, const Stats&) {}
+        static inline void save(const Stats&, double*) {}
+        static inline void restore(Stats&, const double*) {}
+
+        static inline size_t best(ChildStats& children, int parent_n, const Params& params)
+        {
+            return best_ucb1(children, parent_n, params.exploration);
+        }
+    };
+
+    // UCB1-Tuned, the exploration term is bounded by an estimate of the score variance of the child
+    // Scores lie in [-max_score, max_score], so the variance is at most max_score squared
+    struct UCB1Tuned
+    {
+        struct Stats
+        {
+            std::atomic<double> t2{0};
+        };
+
+        static constexpr bool uses_amaf = false;
+
+        static inline void on_expand(Stats&, bool) {}
+
+        static inline void on_visit(Stats& stats, double t)
+        {
+            stats.t2.fetch_add(t * t, std::memory_order_relaxed);
+        }
+
+        static inline void on_amaf(Stats&, double) {}
+
+        static inline void load(ChildStats& children, size_t i, const Stats& stats)
+        {
+            children.extra_t[i] = stats.t2.load(std::memory_order_relaxed);
+        }
+
+        // A lost visit adds max_score squared to the sum of squares, like it adds to n and takes from t
+        static inline void pending(ChildStats& children, size_t i, int loss, double max_score)
+        {
+            children.extra_t[i] += loss * max_score * max_score;
+        }
+
+        static inline void copy(Stats& target, const Stats& source)
+        {
+            target.t2.store(source.t2.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+
+        static inline void save(const Stats& stats, double* values)
+        {
+            values[0] = stats.t2.load(std::memory_order_relaxed);
+        }
+
+        static inline void restore(Stats& stats, const double* values)
+        {
+            stats.t2.store(values[0], std::memory_order_relaxed);
+        }
+
+        static inline size_t best(ChildStats& children, int parent_n, const Params& params)
+        {
+            const size_t count = children.size();
+            const double* t = children.t.data();
+            const double* n = children.n.data();
+            const double* t2 = children.extra_t.data();
+            const std::uint8_t* blocked = children.blocked.data();
+            double* scores = children.scores.data();
+            const double unvisited = parent_n == 0 ? 0.0 : 1.0;
+            const double log_parent_n = parent_n > 0 ? std::log(static_cast<double>(parent_n)) : 0.0;
+            const double max_variance = params.max_score * params.max_score;
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                double visits = std::max(n[i], 1.0);
+                double mean = t[i] / visits;
+                double variance = t2[i] / visits - mean * mean + std::sqrt(2.0 * log_parent_n / visits);
+                double score = mean + std::sqrt(log_parent_n / visits * std::min(max_variance, variance));
+                score = n[i] * unvisited > 0.0 ? score : MAX_SCORE;
+                scores[i] = blocked[i] ? BLOCKED_SCORE : score;
+            }
+            return argmax(scores, count);
+        }
+    };
+
+    // PUCT, mean score plus exploration * P * sqrt(N) / (1 + n) with the prior P of the child
+    // Without a learned prior, captures get CAPTURE_PRIOR times the weight of quiet moves
+    // Priors are normalised over the children when they are scored
+    struct PUCT
+    {
+        static constexpr float CAPTURE_PRIOR = 4.0f;
+
+        struct Stats
+        {
+            float prior{1.0f};
+        };
+
+        static constexpr bool uses_amaf = false;
+
+        static inline void on_expand(Stats& stats, bool capture)
+        {
+            stats.prior = capture ? CAPTURE_PRIOR : 1.0f;
+        }
+
+        static inline void on_visit(Stats&, double) {}
+        static inline void on_amaf(Stats&, double) {}
+
+        static inline void load(ChildStats& children, size_t i, const Stats& stats)
+        {
+            children.extra_t[i] = stats.prior;
+        }
+
+        static inline void pending(ChildStats&, size_t, int, double) {}
+
+        static inline void copy(Stats& target, const Stats& source)
+        {
+            target.prior = source.prior;
+        }
+
+        static inline void save(const Stats& stats, double* values)
+        {
+            values[0] = stats.prior;
+        }
+
+        static inline void restore(Stats& stats, const double* values)
+        {
+            stats.prior = static_cast<float>(values[0]);
+        }
+
+        static inline size_t best(ChildStats& children, int parent_n, const Params& params)
+        {
+            const size_t count = children.size();
+            const double* t = children.t.data();
+            const double* n = children.n.data();
+            const double* prior = children.extra_t.data();
+            const std::uint8_t* blocked = children.blocked.data();
+            double* scores = children.scores.data();
+
+            double prior_sum = 0.0;
+            for (size_t i = 0; i < count; ++i) prior_sum += prior[i];
+            const double exploration = params.exploration * std::sqrt(static_cast<double>(std::max(parent_n, 1))) / std::max(prior_sum, 1e-9);
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                double mean = t[i] / std::max(n[i], 1.0);
+                double score = mean + exploration * prior[i] / (1.0 + n[i]);
+                scores[i] = blocked[i] ? BLOCKED_SCORE : score;
+            }
+            return argmax(scores, count);
+        }
+    };
+
+    // RAVE, blends the mean score with the all-moves-as-first score of the move
+    // The AMAF weight beta = sqrt(EQUIVALENCE / (3n + EQUIVALENCE)) fades as the child collects visits
+    // A move gets an AMAF score whenever its side played it later in the same iteration, in the tree or the rollout
+    struct RAVE
+    {
+        static constexpr double EQUIVALENCE = 1000.0;
+
+        struct Stats
+        {
+            std::atomic<double> amaf_t{0};
+            std::atomic<int> amaf_n{0};
+        };
+
+        static constexpr bool uses_amaf = true;
+
+        static inline void on_expand(Stats&, bool) {}
+        static inline void on_visit(Stats&, double) {}
+
+        static inline void on_amaf(Stats& stats, double t)
+        {
+            stats.amaf_t.fetch_add(t, std::memory_order_relaxed);
+            stats.amaf_n.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        static inline void load(ChildStats& children, size_t i, const Stats& stats)
+        {
+            children.extra_t[i] = stats.amaf_t.load(std::memory_order_relaxed);
+            children.extra_n[i] = stats.amaf_n.load(std::memory_order_relaxed);
+        }
+
+        static inline void pending(ChildStats&, size_t, int, double) {}
+
+        static inline void copy(Stats& target, const Stats& source)
+        {
+            target.amaf_t.store(source.amaf_t.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            target.amaf_n.store(source.amaf_n.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+
+        static inline void save(const Stats& stats, double* values)
+        {
+            values[0] = stats.amaf_t.load(std::memory_order_relaxed);
+            values[1] = stats.amaf_n.load(std::memory_order_relaxed);
+        }
+
+        static inline void restore(Stats& stats, const double* values)
+        {
+            stats.amaf_t.store(values[0], std::memory_order_relaxed);
+            stats.amaf_n.store(static_cast<int>(values[1]), std::memory_order_relaxed);
+        }
+
+        static inline size_t best(ChildStats& children, int parent_n, const Params& params)
+        {
+            const size_t count = children.size();
+            const double* t = children.t.data();
+            const double* n = children.n.data();
+            const double* amaf_t = children.extra_t.data();
+            const double* amaf_n = children.extra_n.data();
+            const std::uint8_t* blocked = children.blocked.data();
+            double* scores = children.scores.data();
+            const double unvisited = parent_n == 0 ? 0.0 : 1.0;
+            const double log_parent_n = parent_n > 0 ? std::log(static_cast<double>(parent_n)) : 0.0;
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                double visits = std::max(n[i], 1.0);
+                double beta = std::sqrt(EQUIVALENCE / (3.0 * n[i] + EQUIVALENCE));
+                double amaf_mean = amaf_t[i] / std::max(amaf_n[i], 1.0);
+                double score = (1.0 - beta) * t[i] / visits + beta * amaf_mean + params.exploration * std::sqrt(log_parent_n / visits);
+                score = n[i] * unvisited > 0.0 ? score : MAX_SCORE;
+                scores[i] = blocked[i] ? BLOCKED_SCORE : score;
+            }
+            return argmax(scores, count);
+        }
+    };
+
+    enum selection_type { ucb1, ucb1_tuned, puct, rave };
+}
+
+#endif /* SELECTION_H */
\ No newline at end of file
@@ -0,0 +1,137 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <chess/chess.hpp>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Binary snapshots of a search tree, for offline analysis and to resume a search later
+// A file is a header, the root position and the nodes in breadth first order, all written as they are in memory
+// The children of a node are contiguous and indices are positions in the file, so reading and writing are block copies
+// Positions and moves are stored raw, a snapshot is only read back by a build with the same chess library
+namespace snapshot
+{
+    constexpr char MAGIC[8] = {'M', 'C', 'T', 'S', 'T', 'R', 'E', 'E'};
+    // The root is checked against transposition::hash, files written with another hash are not read
+    constexpr std::uint32_t VERSION = 2;
+    constexpr std::uint32_t null_index = 0xFFFFFFFF;
+
+    static_assert(std::is_trivially_copyable_v<chess::move>, "moves are written as they are in memory");
+    static_assert(std::is_trivially_copyable_v<chess::position>, "positions are written as they are in memory");
+
+    // Node of a snapshot, t is the score from the side of the move into the node
+    // extra holds the statistics of the selection policy, see the save and restore functions of selection.hpp
+    struct SavedNode
+    {
+        enum flag : std::uint8_t { expanded = 1, terminal = 2 };
+
+        double t{0};
+        double extra[2]{0, 0};
+        std::int32_t n{0};
+        std::uint32_t parent{null_index};
+        std::uint32_t first_child{null_index};
+        std::uint16_t n_children{0};
+        std::uint8_t flags{0};
+        std::uint8_t reserved{0};
+        chess::move move{};
+    };
+
+    struct Header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t node_size;
+        std::uint32_t position_size;
+        std::uint8_t root_turn;
+        std::uint8_t player_side;
+        std::uint16_t reserved;
+        std::uint64_t root_hash;
+        std::uint64_t n_nodes;
+    };
+
+    // Tree of a search, nodes[0] is the root
+    // root_hash is the transposition::hash of root_state, player_side the side whose scores the tree collects
+    struct Snapshot
+    {
+        chess::position root_state = chess::position::from_fen(chess::position::fen_start);
+        chess::side root_turn{chess::side::side_white};
+        chess::side player_side{chess::side::side_white};
+        std::uint64_t root_hash{0};
+        std::vector<SavedNode> nodes{};
+    };
+
+    // Write snapshot to filename, returns false if the file could not be written
+    inline bool write(const std::string& filename, const Snapshot& snapshot)
+    {
+        std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+        Header header{};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.node_size = sizeof(SavedNode);
+        header.position_size = sizeof(chess::position);
+        header.root_turn = static_cast<std::uint8_t>(snapshot.root_turn);
+        header.player_side = static_cast<std::uint8_t>(snapshot.player_side);
+        header.root_hash = snapshot.root_hash;
+        header.n_nodes = snapshot.nodes.size();
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(&snapshot.root_state), sizeof(chess::position));
+        out.write(reinterpret_cast<const char*>(snapshot.nodes.data()), static_cast<std::streamsize>(snapshot.nodes.size() * sizeof(SavedNode)));
+        return static_cast<bool>(out);
+    }
+
+    // Check that nodes form the tree save() writes, every index in range and the children of node i
+    // a contiguous range after i whose nodes name i as their parent
+    inline bool valid_tree(const std::vector<SavedNode>& nodes)
+    {
+        if (nodes.empty() || nodes[0].parent != null_index) return false;
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            const SavedNode& node = nodes[i];
+            if (i > 0)
+            {
+                if (node.parent >= i) return false;
+                const SavedNode& parent = nodes[node.parent];
+                if (parent.n_children == 0 || i < parent.first_child || i >= std::uint64_t{parent.first_child} + parent.n_children) return false;
+            }
+            if (node.n_children == 0) continue;
+            if (node.first_child <= i || std::uint64_t{node.first_child} + node.n_children > nodes.size()) return false;
+            for (std::uint32_t j = node.first_child; j < node.first_child + node.n_children; ++j)
+            {
+                if (nodes[j].parent != i) return false;
+            }
+        }
+        return true;
+    }
+
+    // Read the snapshot of filename, returns false if it is missing, truncated, written by another build
+    // or its nodes do not form a tree in breadth first order, see valid_tree
+    inline bool read(const std::string& filename, Snapshot& snapshot)
+    {
+        std::ifstream in(filename, std::ios::binary | std::ios::ate);
+        std::streamoff file_size = in.tellg();
+        in.seekg(0);
+        Header header{};
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION
+            || header.node_size != sizeof(SavedNode) || header.position_size != sizeof(chess::position) || header.n_nodes == 0
+            || header.root_turn > 1 || header.player_side > 1
+            || header.n_nodes > static_cast<std::uint64_t>(file_size) / sizeof(SavedNode)
+            || static_cast<std::uint64_t>(file_size) != sizeof(Header) + sizeof(chess::position) + header.n_nodes * sizeof(SavedNode))
+        {
+            return false;
+        }
+        if (!in.read(reinterpret_cast<char*>(&snapshot.root_state), sizeof(chess::position))) return false;
+        snapshot.root_turn = static_cast<chess::side>(header.root_turn);
+        snapshot.player_side = static_cast<chess::side>(header.player_side);
+        snapshot.root_hash = header.root_hash;
+        snapshot.nodes.resize(header.n_nodes);
+        if (!in.read(reinterpret_cast<char*>(snapshot.nodes.data()), static_cast<std::streamsize>(header.n_nodes * sizeof(SavedNode)))) return false;
+        return valid_tree(snapshot.nodes);
+    }
+}
+
+#endif /* SNAPSHOT_H */
\ No newline at end of file
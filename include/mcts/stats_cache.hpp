@@ -0,0 +1,288 @@
+#ifndef STATS_CACHE_H
+#define STATS_CACHE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// On-disk cache of root statistics keyed by position hash, shared by searches, games and processes
+// The file holds a header, an open addressing table of slots and the records appended behind it
+// It is mapped once at its largest size, so records are read in place and appending never remaps
+// Readers hold a shared file lock and writers an exclusive one, so several processes may use one file
+namespace stats_cache
+{
+    constexpr size_t RECORD_MOVES = 64;
+    // Records are keyed by transposition::hash, files written with another hash are not read
+    constexpr std::uint32_t VERSION = 3;
+    constexpr char MAGIC[8] = {'M', 'C', 'T', 'S', 'S', 'T', 'A', 'T'};
+    constexpr const char* DEFAULT_FILE = "stats_cache.bin";
+
+    // Visits and summed score of one root move from the side to move, lan is its long algebraic notation
+    struct MoveStats
+    {
+        char lan[8]{};
+        double t{0};
+        std::uint64_t n{0};
+    };
+
+    // Root statistics of one position, moves past RECORD_MOVES are not kept
+    struct Record
+    {
+        std::uint64_t key{0};
+        std::uint32_t n_moves{0};
+        std::uint32_t reserved{0};
+        MoveStats moves[RECORD_MOVES]{};
+    };
+
+    // Table slot, record is the index of the record plus one and 0 in an empty slot
+    struct Slot
+    {
+        std::uint64_t key;
+        std::uint64_t record;
+    };
+
+    // A file is only opened by a build with the same version, record layout and moves per record
+    struct Header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t record_size;
+        std::uint32_t record_moves;
+        std::uint32_t reserved;
+        std::uint64_t slots;
+        std::uint64_t records;
+    };
+
+    // Memory mapped statistics file, at most three records per four slots
+    // Threads of one process share a Cache, file locks keep other processes out while it reads or writes
+    class Cache
+    {
+        public:
+            static constexpr size_t DEFAULT_SLOTS = size_t{1} << 14;
+
+            // Open or create filename, slots is the table size of a new file, rounded up to a power of two
+            // A file that cannot be mapped, was written by another version or claims more records than fit leaves the cache closed
+            explicit Cache(const std::string& filename, size_t slots = DEFAULT_SLOTS)
+            {
+#ifndef _WIN32
+                fd = ::open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+                if (fd < 0) return;
+                ::flock(fd, LOCK_EX);
+                struct stat file_stat{};
+                Header header{};
+                bool valid = ::fstat(fd, &file_stat) == 0;
+                if (valid && file_stat.st_size == 0)
+                {
+                    size_t table_size = 1;
+                    while (table_size < slots) table_size <<= 1;
+                    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+                    header.version = VERSION;
+                    header.record_size = sizeof(Record);
+                    header.record_moves = RECORD_MOVES;
+                    header.slots = table_size;
+                    header.records = 0;
+                    valid = ::ftruncate(fd, static_cast<off_t>(records_offset(table_size))) == 0
+                        && ::pwrite(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header));
+                }
+                else if (valid)
+                {
+                    valid = ::pread(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header))
+                        && std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0
+                        && header.version == VERSION
+                        && header.record_size == sizeof(Record)
+                        && header.record_moves == RECORD_MOVES
+                        && header.slots > 0 && (header.slots & (header.slots - 1)) == 0
+                        && header.records <= header.slots / 4 * 3;
+                }
+                if (valid)
+                {
+                    n_slots = header.slots;
+                    mapped_bytes = records_offset(n_slots) + max_records() * sizeof(Record);
+                    void* address = ::mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                    if (address != MAP_FAILED) base = static_cast<char*>(address);
+                }
+                ::flock(fd, LOCK_UN);
+                if (!base)
+                {
+                    ::close(fd);
+                    fd = -1;
+                }
+#else
+                (void)filename;
+                (void)slots;
+#endif
+            }
+
+            Cache(const Cache&) = delete;
+            Cache& operator=(const Cache&) = delete;
+
+            ~Cache()
+            {
+#ifndef _WIN32
+                if (base) ::munmap(base, mapped_bytes);
+                if (fd >= 0) ::close(fd);
+#endif
+            }
+
+            bool is_open() const
+            {
+                return base != nullptr;
+            }
+
+            // Call use with the record of key, read in place from the mapped file under a shared lock
+            // A record claiming more than RECORD_MOVES moves is handed over as a copy cut down to them
+            // Returns false without calling use if the position is not cached
+            template<typename Use>
+            bool read(std::uint64_t key, Use&& use)
+            {
+                if (!is_open()) return false;
+                std::lock_guard<std::mutex> lock{mutex};
+                FileLock file_lock{fd, false};
+                Slot* slot = probe(key);
+                if (!slot || slot->record == 0 || slot->record > header().records) return false;
+                const Record& record = records()[slot->record - 1];
+                if (record.n_moves <= RECORD_MOVES)
+                {
+                    use(record);
+                }
+                else
+                {
+                    Record clamped = record;
+                    clamped.n_moves = RECORD_MOVES;
+                    use(static_cast<const Record&>(clamped));
+                }
+                return true;
+            }
+
+            // Add the visits and scores of deltas to the record of key, which is appended if it is new
+            // Nothing is stored once the table is full or no slot is free, moves past RECORD_MOVES are dropped
+            void merge(std::uint64_t key, const std::vector<MoveStats>& deltas)
+            {
+                if (!is_open() || deltas.empty()) return;
+                std::lock_guard<std::mutex> lock{mutex};
+                FileLock file_lock{fd, true};
+                Slot* slot = probe(key);
+                if (!slot) return;
+                if (slot->record == 0)
+                {
+                    Header& file_header = header();
+                    std::uint64_t index = file_header.records;
+#ifndef _WIN32
+                    if (index >= max_records() || ::ftruncate(fd, static_cast<off_t>(records_offset(n_slots) + (index + 1) * sizeof(Record))) != 0) return;
+#endif
+                    records()[index] = Record{};
+                    records()[index].key = key;
+                    slot->key = key;
+                    slot->record = index + 1;
+                    file_header.records = index + 1;
+                }
+                if (slot->record > header().records) return;
+                Record& record = records()[slot->record - 1];
+                record.n_moves = std::min<std::uint32_t>(record.n_moves, RECORD_MOVES);
+                for (const MoveStats& delta : deltas)
+                {
+                    std::uint32_t i = 0;
+                    while (i < record.n_moves && std::strncmp(record.moves[i].lan, delta.lan, sizeof(delta.lan)) != 0) ++i;
+                    if (i == RECORD_MOVES) continue;
+                    if (i == record.n_moves)
+                    {
+                        record.moves[i] = MoveStats{};
+                        std::memcpy(record.moves[i].lan, delta.lan, sizeof(delta.lan));
+                        ++record.n_moves;
+                    }
+                    record.moves[i].t += delta.t;
+                    record.moves[i].n += delta.n;
+                }
+            }
+
+            // Amount of cached positions
+            size_t size()
+            {
+                if (!is_open()) return 0;
+                std::lock_guard<std::mutex> lock{mutex};
+                FileLock file_lock{fd, false};
+                return header().records;
+            }
+
+        private:
+            // flock for the lifetime of the object, exclusive or shared
+            struct FileLock
+            {
+                FileLock(int fd, bool exclusive)
+                    : fd{fd}
+                {
+#ifndef _WIN32
+                    ::flock(fd, exclusive ? LOCK_EX : LOCK_SH);
+#else
+                    (void)exclusive;
+#endif
+                }
+
+                ~FileLock()
+                {
+#ifndef _WIN32
+                    ::flock(fd, LOCK_UN);
+#endif
+                }
+
+                int fd;
+            };
+
+            static size_t records_offset(size_t slots)
+            {
+                return sizeof(Header) + slots * sizeof(Slot);
+            }
+
+            size_t max_records() const
+            {
+                return n_slots / 4 * 3;
+            }
+
+            Header& header()
+            {
+                return *reinterpret_cast<Header*>(base);
+            }
+
+            Slot* slots()
+            {
+                return reinterpret_cast<Slot*>(base + sizeof(Header));
+            }
+
+            Record* records()
+            {
+                return reinterpret_cast<Record*>(base + records_offset(n_slots));
+            }
+
+            // Slot holding key, or the empty slot where it belongs
+            // nullptr after n_slots probes, records stop at three quarters of the slots so only a damaged file has no empty slot
+            Slot* probe(std::uint64_t key)
+            {
+                size_t mask = n_slots - 1;
+                size_t i = key & mask;
+                for (size_t probes = 0; probes < n_slots; ++probes, i = (i + 1) & mask)
+                {
+                    Slot& slot = slots()[i];
+                    if (slot.record == 0 || slot.key == key) return &slot;
+                }
+                return nullptr;
+            }
+
+            int fd{-1};
+            char* base{nullptr};
+            size_t mapped_bytes{0};
+            size_t n_slots{0};
+            std::mutex mutex{};
+    };
+}
+
+#endif /* STATS_CACHE_H */
\ No newline at end of file
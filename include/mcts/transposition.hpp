@@ -0,0 +1,318 @@
+#ifndef TRANSPOSITION_H
+#define TRANSPOSITION_H
+
+#include <chess/chess.hpp>
+#include <mcts/eval.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <string>
+
+// Transposition table that lets positions reached by different move orders share one node
+namespace transposition
+{
+    using index_type = std::uint32_t;
+    constexpr index_type null_index = std::numeric_limits<index_type>::max();
+
+    // Random Zobrist keys of the pieces on every square, the side to move, the castling rights and the en passant file
+    // Drawn from a fixed seed, so keys agree between processes and builds
+    struct Keys
+    {
+        Keys()
+        {
+            std::uint64_t seed = 0x9E3779B97F4A7C15ull;
+            for (std::array<std::uint64_t, 64>& square_keys : pieces)
+            {
+                for (std::uint64_t& key : square_keys) key = splitmix64(seed);
+            }
+            pieces[6].fill(0);
+            black_to_move = splitmix64(seed);
+            for (std::uint64_t& key : castling) key = splitmix64(seed);
+            for (std::uint64_t& key : en_passant) key = splitmix64(seed);
+        }
+
+        static std::uint64_t splitmix64(std::uint64_t& seed)
+        {
+            std::uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+        // Key of an eval piece code on square, an empty square has the key 0
+        inline std::uint64_t piece(std::int8_t piece, int square) const
+        {
+            return pieces[piece + 6][square];
+        }
+
+        std::array<std::array<std::uint64_t, 64>, 13> pieces;
+        std::uint64_t black_to_move;
+        std::array<std::uint64_t, 16> castling;
+        std::array<std::uint64_t, 8> en_passant;
+    };
+
+    inline const Keys& keys()
+    {
+        static const Keys zobrist_keys{};
+        return zobrist_keys;
+    }
+
+    // Castling rights, one bit per king and side
+    enum : std::uint8_t { white_king_side = 1, white_queen_side = 2, black_king_side = 4, black_queen_side = 8 };
+
+    // Rights lost by a move from or to each square, the squares of the kings and rooks
+    constexpr std::array<std::uint8_t, 64> CASTLING_LOST = []()
+    {
+        std::array<std::uint8_t, 64> lost{};
+        lost[0] = white_queen_side;
+        lost[4] = white_king_side | white_queen_side;
+        lost[7] = white_king_side;
+        lost[56] = black_queen_side;
+        lost[60] = black_king_side | black_queen_side;
+        lost[63] = black_king_side;
+        return lost;
+    }();
+
+    // Zobrist key of a position, kept up to date move by move with play
+    // The chess library does not expose castling rights or the en passant square, so a position read with the constructor
+    // has the rights of every king and rook on its home squares and the en passant file of a legal en passant capture
+    // From there play clears rights as kings and rooks move or are captured, and sets the file of a double pawn push
+    // next to an enemy pawn, the clocks of the position are not part of the key
+    struct Key
+    {
+        explicit Key(const chess::position& state)
+            : board{state}
+        {
+            const Keys& zobrist = keys();
+            for (int square = 0; square < 64; ++square) value ^= zobrist.piece(board.squares[square], square);
+            if (state.get_turn() == chess::side::side_black) value ^= zobrist.black_to_move;
+            if (board.squares[4] == eval::king)
+            {
+                if (board.squares[7] == eval::rook) castling |= white_king_side;
+                if (board.squares[0] == eval::rook) castling |= white_queen_side;
+            }
+            if (board.squares[60] == -eval::king)
+            {
+                if (board.squares[63] == -eval::rook) castling |= black_king_side;
+                if (board.squares[56] == -eval::rook) castling |= black_queen_side;
+            }
+            value ^= zobrist.castling[castling];
+            for (const chess::move& move : state.moves())
+            {
+                eval::Move parsed = eval::parse(move);
+                if (std::abs(board.mover(parsed)) == eval::pawn && parsed.from % 8 != parsed.to % 8 && board.squares[parsed.to] == eval::empty)
+                {
+                    en_passant_file = static_cast<std::int8_t>(parsed.to % 8);
+                    value ^= zobrist.en_passant[en_passant_file];
+                    break;
+                }
+            }
+        }
+
+        // Update the key to the position after move
+        void play(const chess::move& move)
+        {
+            const Keys& zobrist = keys();
+            eval::Move parsed = eval::parse(move);
+            std::int8_t piece = board.mover(parsed);
+            // Squares the move may change, the passed pawn of en passant and the rook of castling included
+            std::array<int, 4> touched{parsed.from, parsed.to, parsed.from, parsed.to};
+            if (std::abs(piece) == eval::pawn && parsed.from % 8 != parsed.to % 8) touched[2] = parsed.from / 8 * 8 + parsed.to % 8;
+            if (std::abs(piece) == eval::king && std::abs(parsed.from % 8 - parsed.to % 8) == 2)
+            {
+                bool king_side = parsed.to % 8 == 6;
+                touched[2] = parsed.from / 8 * 8 + (king_side ? 7 : 0);
+                touched[3] = parsed.from / 8 * 8 + (king_side ? 5 : 3);
+            }
+            std::array<std::int8_t, 4> before{};
+            for (size_t i = 0; i < touched.size(); ++i) before[i] = board.squares[touched[i]];
+            board.play(parsed);
+            for (size_t i = 0; i < touched.size(); ++i)
+            {
+                if (std::find(touched.begin(), touched.begin() + i, touched[i]) != touched.begin() + i) continue;
+                value ^= zobrist.piece(before[i], touched[i]) ^ zobrist.piece(board.squares[touched[i]], touched[i]);
+            }
+
+            value ^= zobrist.castling[castling];
+            castling &= static_cast<std::uint8_t>(~(CASTLING_LOST[parsed.from] | CASTLING_LOST[parsed.to]));
+            value ^= zobrist.castling[castling];
+
+            if (en_passant_file >= 0) value ^= zobrist.en_passant[en_passant_file];
+            en_passant_file = -1;
+            if (std::abs(piece) == eval::pawn && std::abs(parsed.to - parsed.from) == 16)
+            {
+                int file = parsed.to % 8;
+                bool left = file > 0 && board.squares[parsed.to - 1] == -piece;
+                bool right = file < 7 && board.squares[parsed.to + 1] == -piece;
+                if (left || right)
+                {
+                    en_passant_file = static_cast<std::int8_t>(file);
+                    value ^= zobrist.en_passant[en_passant_file];
+                }
+            }
+            value ^= zobrist.black_to_move;
+        }
+
+        eval::Board board;
+        std::uint64_t value{0};
+        std::uint8_t castling{0};
+        std::int8_t en_passant_file{-1};
+    };
+
+    // Zobrist key of state, see Key
+    // Reads the board diagram and generates the moves of state, follow moves with Key::play where that matters
+    inline std::uint64_t hash(const chess::position& state)
+    {
+        return Key{state}.value;
+    }
+
+    // Table entry, depth is the ply from the root of the node
+    // Entries of an older generation count as empty
+    struct Entry
+    {
+        std::uint64_t key{0};
+        index_type node{null_index};
+        std::uint16_t depth{0};
+        std::uint16_t generation{0};
+    };
+
+    // Bounded table of BUCKET_SIZE entries per bucket, safe to share between workers without locks
+    // A slot keeps the key xor its packed data next to the data, a slot torn by two workers writing at once
+    // fails the key check and reads as empty
+    // Only nodes at the same depth are linked, which keeps the graph free of cycles
+    // A full bucket replaces the entry whose node has the fewest visits
+    class Table
+    {
+        public:
+            static constexpr size_t BUCKET_SIZE = 4;
+
+            // size is the amount of entries, rounded down to a power of two, 0 disables the table
+            Table(size_t size = 0)
+            {
+                resize(size);
+            }
+
+            // Not safe while other workers use the table
+            void resize(size_t size)
+            {
+                size_t buckets = 1;
+                while (buckets * 2 * BUCKET_SIZE <= size) buckets *= 2;
+                n_slots = size >= BUCKET_SIZE ? buckets * BUCKET_SIZE : 0;
+                slots.reset(n_slots ? new Slot[n_slots] : nullptr);
+                mask = n_slots ? buckets - 1 : 0;
+            }
+
+            bool enabled() const
+            {
+                return n_slots != 0;
+            }
+
+            // Get the node stored for key at depth, null_index if there is none
+            index_type probe(std::uint64_t key, std::uint16_t depth)
+            {
+                probes.fetch_add(1, std::memory_order_relaxed);
+                Slot* bucket = &slots[(key & mask) * BUCKET_SIZE];
+                for (size_t i = 0; i < BUCKET_SIZE; ++i)
+                {
+                    Entry entry = bucket[i].load();
+                    if (entry.generation == generation && entry.key == key && entry.depth == depth)
+                    {
+                        hits.fetch_add(1, std::memory_order_relaxed);
+                        return entry.node;
+                    }
+                }
+                return null_index;
+            }
+
+            // Store node for key at depth, visits(node) gives the visit count used for replacement
+            template<typename Visits>
+            void store(std::uint64_t key, std::uint16_t depth, index_type node, Visits visits)
+            {
+                stores.fetch_add(1, std::memory_order_relaxed);
+                Slot* bucket = &slots[(key & mask) * BUCKET_SIZE];
+                Slot* victim = nullptr;
+                int victim_visits = 0;
+                for (size_t i = 0; i < BUCKET_SIZE; ++i)
+                {
+                    Entry entry = bucket[i].load();
+                    if (entry.generation != generation)
+                    {
+                        victim = &bucket[i];
+                        break;
+                    }
+                    int entry_visits = visits(entry.node);
+                    if (!victim || entry_visits < victim_visits)
+                    {
+                        victim = &bucket[i];
+                        victim_visits = entry_visits;
+                    }
+                }
+                if (victim->load().generation == generation) replacements.fetch_add(1, std::memory_order_relaxed);
+                victim->store(Entry{key, node, depth, generation});
+            }
+
+            // Forget every entry in O(1) by starting a new generation, counters are kept
+            // Call between searches
+            void clear()
+            {
+                if (++generation == 0)
+                {
+                    for (size_t i = 0; i < n_slots; ++i) slots[i].store(Entry{});
+                    generation = 1;
+                }
+            }
+
+            // Hit rate and occupancy counters
+            std::string report() const
+            {
+                size_t n_probes = probes.load(std::memory_order_relaxed);
+                size_t n_hits = hits.load(std::memory_order_relaxed);
+                std::string report = "-- Transposition Report --";
+                report += "\nentries: " + std::to_string(n_slots);
+                report += "\nprobes: " + std::to_string(n_probes);
+                report += "\nhits: " + std::to_string(n_hits);
+                report += "\nhit rate: " + std::to_string(n_probes ? n_hits / double(n_probes) : 0.0);
+                report += "\nstores: " + std::to_string(stores.load(std::memory_order_relaxed));
+                report += "\nreplacements: " + std::to_string(replacements.load(std::memory_order_relaxed));
+                return report;
+            }
+
+            std::atomic<size_t> probes{0};
+            std::atomic<size_t> hits{0};
+            std::atomic<size_t> stores{0};
+            std::atomic<size_t> replacements{0};
+
+        private:
+            // Entry packed into two words, check holds the key xor data
+            struct Slot
+            {
+                Entry load() const
+                {
+                    std::uint64_t packed = data.load(std::memory_order_relaxed);
+                    std::uint64_t key = check.load(std::memory_order_relaxed) ^ packed;
+                    return Entry{key, static_cast<index_type>(packed), static_cast<std::uint16_t>(packed >> 32), static_cast<std::uint16_t>(packed >> 48)};
+                }
+
+                void store(const Entry& entry)
+                {
+                    std::uint64_t packed = entry.node | std::uint64_t{entry.depth} << 32 | std::uint64_t{entry.generation} << 48;
+                    check.store(entry.key ^ packed, std::memory_order_relaxed);
+                    data.store(packed, std::memory_order_relaxed);
+                }
+
+                std::atomic<std::uint64_t> check{0};
+                std::atomic<std::uint64_t> data{0};
+            };
+
+            std::unique_ptr<Slot[]> slots{};
+            size_t n_slots{0};
+            size_t mask{0};
+            std::uint16_t generation{1};
+    };
+}
+
+#endif /* TRANSPOSITION_H */
\ No newline at end of file
@@ -0,0 +1,338 @@
+#ifndef UCI_H
+#define UCI_H
+
+#include <mcts/mcts_model.hpp>
+#include <mcts/match.hpp>
+#include <mcts/budget.hpp>
+#include <mcts/rng.hpp>
+#include <chess/chess.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Universal Chess Interface front-end for the models
+namespace uci
+{
+    // Parameters of a go command, times in milliseconds
+    struct Go
+    {
+        int wtime = 0;
+        int btime = 0;
+        int winc = 0;
+        int binc = 0;
+        int movestogo = 0;
+        int movetime = 0;
+        size_t nodes = 0;
+        bool infinite = false;
+        bool ponder = false;
+    };
+
+    // Time kept back for the GUI and the output of the move
+    constexpr int MOVE_OVERHEAD_MS = 30;
+    // Interval of the info lines of a running search
+    constexpr int INFO_MS = 500;
+
+    // Milliseconds to search the move of turn, 0 if the go command sets no time
+    // Without movestogo the remaining time is spread over 30 moves, most of the increment is used as well
+    int move_time(const Go& go, chess::side turn)
+    {
+        if (go.movetime) return go.movetime;
+        int time = turn == chess::side::side_white ? go.wtime : go.btime;
+        int increment = turn == chess::side::side_white ? go.winc : go.binc;
+        if (time <= 0) return 0;
+        int moves_to_go = go.movestogo > 0 ? go.movestogo : 30;
+        int budget = time / moves_to_go + increment * 3 / 4;
+        return std::max(1, std::min(budget, time - std::min(time / 2, MOVE_OVERHEAD_MS)));
+    }
+
+    // Find the legal move of state written as lan, false if there is none
+    bool parse_move(const chess::position& state, const std::string& lan, chess::move& move)
+    {
+        for (const chess::move& legal_move : state.moves())
+        {
+            if (legal_move.to_lan() == lan)
+            {
+                move = legal_move;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // UCI engine, command() handles one line of input
+    // Searches run on a background thread that polls a stop flag between iterations
+    // A clock thread sets the flag when the time of the move is up, so stop and time control answer once the running iteration ends,
+    // that is after the ROLLOUT_SIMULATIONS playouts of one leaf, or of BATCH_SIZE leaves with batches
+    // Models 0, 1, 2 and 4 keep their tree between moves, moves since the last search are passed to Model::advance
+    // go ponder searches without a clock until ponderhit starts it, the tree of the pondering search is kept
+    class Engine
+    {
+        public:
+            Engine(match::Settings settings, std::ostream& out, std::uint64_t seed = 0)
+                : settings{settings},
+                out{out},
+                seed{seed}
+            {
+                this->settings.options.reuse_tree = true;
+            }
+            Engine(const Engine&) = delete;
+            Engine& operator=(const Engine&) = delete;
+            ~Engine()
+            {
+                stop_search();
+            }
+
+            // Handle one command, returns false on quit
+            bool command(const std::string& line)
+            {
+                std::istringstream args(line);
+                std::string name;
+                args >> name;
+                if (name == "uci")
+                {
+                    send("id name mcts-chess\nid author mcts-chess\noption name Ponder type check default true\nuciok");
+                }
+                else if (name == "isready")
+                {
+                    send("readyok");
+                }
+                else if (name == "ucinewgame")
+                {
+                    stop_search();
+                    model.reset();
+                }
+                else if (name == "position")
+                {
+                    stop_search();
+                    set_position(args);
+                }
+                else if (name == "go")
+                {
+                    stop_search();
+                    go(args);
+                }
+                else if (name == "stop")
+                {
+                    stop_search();
+                }
+                else if (name == "ponderhit")
+                {
+                    ponderhit();
+                }
+                else if (name == "quit")
+                {
+                    stop_search();
+                    return false;
+                }
+                return true;
+            }
+
+        private:
+            // position [startpos | fen <fen>] [moves <move>...]
+            void set_position(std::istringstream& args)
+            {
+                std::string token;
+                args >> token;
+                std::string fen{chess::position::fen_start};
+                if (token == "fen")
+                {
+                    fen.clear();
+                    while (args >> token && token != "moves") fen += (fen.empty() ? "" : " ") + token;
+                }
+                else
+                {
+                    args >> token;
+                }
+                root_fen = fen;
+                state = chess::position::from_fen(fen);
+                moves.clear();
+                if (token != "moves") return;
+                while (args >> token)
+                {
+                    chess::move move;
+                    if (!parse_move(state, token, move))
+                    {
+                        send("info string illegal move " + token);
+                        break;
+                    }
+                    state.make_move(move);
+                    moves.push_back(move);
+                }
+            }
+
+            // Hand the model the moves since its last search, or start a new one for another game or side
+            void sync_model()
+            {
+                chess::side turn = state.get_turn();
+                bool continues = model && model_side == turn && model_fen == root_fen && model_moves.size() <= moves.size();
+                for (size_t i = 0; continues && i < model_moves.size(); ++i)
+                {
+                    continues = model_moves[i].to_lan() == moves[i].to_lan();
+                }
+                if (continues)
+                {
+                    for (size_t i = model_moves.size(); i < moves.size(); ++i) model->advance(moves[i]);
+                }
+                else
+                {
+                    model = match::make_player(settings, turn, rng::stream_seed(seed, n_models++));
+                    model_side = turn;
+                    model_fen = root_fen;
+                }
+                model_moves = moves;
+            }
+
+            // go [wtime <ms>] [btime <ms>] [winc <ms>] [binc <ms>] [movestogo <n>] [movetime <ms>] [nodes <n>] [infinite] [ponder]
+            void go(std::istringstream& args)
+            {
+                Go parameters{};
+                std::string token;
+                while (args >> token)
+                {
+                    if (token == "wtime") args >> parameters.wtime;
+                    else if (token == "btime") args >> parameters.btime;
+                    else if (token == "winc") args >> parameters.winc;
+                    else if (token == "binc") args >> parameters.binc;
+                    else if (token == "movestogo") args >> parameters.movestogo;
+                    else if (token == "movetime") args >> parameters.movetime;
+                    else if (token == "nodes") args >> parameters.nodes;
+                    else if (token == "infinite") parameters.infinite = true;
+                    else if (token == "ponder") parameters.ponder = true;
+                }
+
+                if (state.moves().empty())
+                {
+                    send("bestmove 0000");
+                    return;
+                }
+                sync_model();
+
+                // Nodes are counted as iterations, like the nodes of the info lines
+                budget::Limits limits{};
+                limits.iterations = static_cast<int>(parameters.nodes);
+                limits.stop = &stop;
+                limits.info_ms = INFO_MS;
+                limits.info = [this](const budget::Usage& usage) { send(info(usage)); };
+                int milliseconds = move_time(parameters, state.get_turn());
+                if (!parameters.infinite && !parameters.ponder && !parameters.nodes && !milliseconds) limits.iterations = settings.limits.iterations;
+
+                stop.store(false);
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    holding = parameters.infinite || parameters.ponder;
+                    clock_cancelled = false;
+                }
+                ponder_ms = milliseconds;
+                if (!parameters.ponder && !parameters.infinite && milliseconds) start_clock(milliseconds);
+
+                search_thread = std::thread([this, limits]()
+                {
+                    chess::move best_move{model->search(state, limits)};
+                    // bestmove waits for stop or ponderhit while pondering or searching infinitely
+                    {
+                        std::unique_lock<std::mutex> lock{mutex};
+                        hold_cv.wait(lock, [this]() { return !holding || stop.load(); });
+                    }
+                    std::vector<chess::move> pv = model->principal_variation();
+                    std::string result = info(model->last_usage) + "\nbestmove " + best_move.to_lan();
+                    if (pv.size() > 1 && pv.front().to_lan() == best_move.to_lan()) result += " ponder " + pv[1].to_lan();
+                    send(result);
+                });
+            }
+
+            // The opponent played the pondered move, search on against the clock of the go ponder command
+            void ponderhit()
+            {
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    holding = false;
+                }
+                hold_cv.notify_all();
+                // Without a clock the time spent pondering was the search
+                if (ponder_ms) start_clock(ponder_ms);
+                else stop.store(true);
+            }
+
+            // Set the stop flag once milliseconds have passed, unless the clock is cancelled first
+            void start_clock(int milliseconds)
+            {
+                if (clock_thread.joinable()) clock_thread.join();
+                clock_thread = std::thread([this, milliseconds]()
+                {
+                    std::unique_lock<std::mutex> lock{mutex};
+                    if (!clock_cv.wait_for(lock, std::chrono::milliseconds(milliseconds), [this]() { return clock_cancelled; })) stop.store(true);
+                });
+            }
+
+            // Stop a running search and wait until it has sent its bestmove
+            void stop_search()
+            {
+                stop.store(true);
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    clock_cancelled = true;
+                }
+                hold_cv.notify_all();
+                clock_cv.notify_all();
+                if (search_thread.joinable()) search_thread.join();
+                if (clock_thread.joinable()) clock_thread.join();
+            }
+
+            // info line with the nodes, speed and principal variation of the search so far
+            std::string info(const budget::Usage& usage) const
+            {
+                std::vector<chess::move> pv = model->principal_variation();
+                std::string line = "info depth " + std::to_string(pv.size());
+                line += " nodes " + std::to_string(usage.iterations);
+                line += " nps " + std::to_string(usage.milliseconds > 0 ? static_cast<long>(usage.iterations * 1000.0 / usage.milliseconds) : 0);
+                line += " time " + std::to_string(static_cast<long>(usage.milliseconds));
+                if (!pv.empty())
+                {
+                    line += " pv";
+                    for (const chess::move& move : pv) line += ' ' + move.to_lan();
+                }
+                return line;
+            }
+
+            void send(const std::string& text)
+            {
+                std::lock_guard<std::mutex> lock{out_mutex};
+                out << text << std::endl;
+            }
+
+            match::Settings settings;
+            std::ostream& out;
+            std::uint64_t seed;
+            std::uint64_t n_models{0};
+
+            chess::position state = chess::position::from_fen(chess::position::fen_start);
+            std::string root_fen{chess::position::fen_start};
+            std::vector<chess::move> moves{};
+
+            std::unique_ptr<mcts_model::Model> model{};
+            chess::side model_side{chess::side::side_white};
+            std::string model_fen{};
+            std::vector<chess::move> model_moves{};
+
+            std::thread search_thread{};
+            std::thread clock_thread{};
+            std::atomic<bool> stop{false};
+            std::mutex mutex{};
+            std::mutex out_mutex{};
+            std::condition_variable hold_cv{};
+            std::condition_variable clock_cv{};
+            bool holding{false};
+            bool clock_cancelled{false};
+            int ponder_ms{0};
+    };
+}
+
+#endif /* UCI_H */
\ No newline at end of file
@@ -0,0 +1,58 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chess/chess.hpp>
+#include <mcts/instrument.hpp>
+#include <mcts/node.hpp>
+#include <mcts/policy.hpp>
+#include <mcts/mcts_model.hpp>
+#include <mcts/evaluator.hpp>
+#include <mcts/selection.hpp>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <string>
+#include <memory>
+#include <thread>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Every benchmark takes the arguments of the program, argv[1] is its name
+
+// tree.cpp
+int bench_tree(int argc, char* argv[]);
+int bench_threads(int argc, char* argv[]);
+int bench_expand(int argc, char* argv[]);
+int bench_memory(int argc, char* argv[]);
+int bench_snapshot(int argc, char* argv[]);
+
+// kernels.cpp
+int bench_rollout(int argc, char* argv[]);
+int bench_batch(int argc, char* argv[]);
+int bench_select(int argc, char* argv[]);
+int bench_backprop(int argc, char* argv[]);
+int bench_policy(int argc, char* argv[]);
+int bench_evaluator(int argc, char* argv[]);
+
+// games.cpp
+int bench_match(int argc, char* argv[]);
+int bench_selection(int argc, char* argv[]);
+int bench_heuristic(int argc, char* argv[]);
+int bench_solver(int argc, char* argv[]);
+
+// suite.cpp
+int bench_suite(int argc, char* argv[]);
+int bench_cache(int argc, char* argv[]);
+
+// Positions of the benchmark suite, openings, middlegames and endgames
+extern const std::vector<std::pair<std::string, std::string>> SUITE_POSITIONS;
+
+#endif /* BENCH_H */
\ No newline at end of file
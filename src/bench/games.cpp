@@ -0,0 +1,236 @@
+// Playing strength of models, policies and the solver in games against each other
+#include "bench.hpp"
+
+// Play one game, returns 1 if white wins, -1 if black wins and 0 for a draw
+int play_game(mcts_model::Model& white, int white_iter, mcts_model::Model& black, int black_iter, int max_moves)
+{
+    chess::position game_board = chess::position::from_fen(chess::position::fen_start);
+    for(int moves = 0 ; moves < max_moves ; ++moves)
+    {
+        game_board.make_move(white.search(game_board, white_iter));
+        if(game_board.is_checkmate()) return 1;
+        if(game_board.is_stalemate()) return 0;
+        game_board.make_move(black.search(game_board, black_iter));
+        if(game_board.is_checkmate()) return -1;
+        if(game_board.is_stalemate()) return 0;
+    }
+    return 0;
+}
+
+// Wins, draws and losses of one side of a match
+struct MatchScore
+{
+    std::string to_string() const
+    {
+        return std::to_string(wins) + '/' + std::to_string(draws) + '/' + std::to_string(losses);
+    }
+
+    int wins{0};
+    int draws{0};
+    int losses{0};
+};
+
+// Play games between models A and B, alternating colours, scored for A
+MatchScore play_match(mcts_model::Model& a_white, mcts_model::Model& a_black, int iter_a, mcts_model::Model& b_white, mcts_model::Model& b_black, int iter_b, int games, int max_moves)
+{
+    MatchScore score{};
+    for(int game = 0 ; game < games ; ++game)
+    {
+        bool a_is_white = game % 2 == 0;
+        int result = a_is_white ? play_game(a_white, iter_a, b_black, iter_b, max_moves) : -play_game(b_white, iter_b, a_black, iter_a, max_moves);
+        if(result > 0) ++score.wins;
+        else if(result < 0) ++score.losses;
+        else ++score.draws;
+    }
+    return score;
+}
+
+// Iterations per second of model from the start position
+double iterations_per_sec(mcts_model::Model& model, int iterations)
+{
+    chess::position state = chess::position::from_fen(chess::position::fen_start);
+    Timer timer{};
+    model.search(state, iterations);
+    return iterations / timer.get_time();
+}
+
+// Head to head games between two model types at equal wall time per move
+// Each model gets as many iterations per move as it manages in MS_PER_MOVE from the start position
+int bench_match(int argc, char* argv[])
+{
+    int type_a = argc > 2 ? std::stoi(argv[2]) : mcts_model::root_parallel_model;
+    int type_b = argc > 3 ? std::stoi(argv[3]) : mcts_model::leaf_parallel_model;
+    int games = argc > 4 ? std::stoi(argv[4]) : 10;
+    double ms_per_move = argc > 5 ? std::stod(argv[5]) : 100;
+    int n_threads = argc > 6 ? std::stoi(argv[6]) : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    int simulations = 10;
+    int max_moves = 100;
+
+    auto policy_for = [&](int type)
+    {
+        int n_iter = type == mcts_model::leaf_parallel_model ? (simulations + n_threads - 1) / n_threads : simulations;
+        return node::policy_function_type{std::bind(policy::rollout::random_rollout, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, n_iter)};
+    };
+    // Fixed seeds, one random stream per model
+    auto options_for = [&](std::uint64_t stream)
+    {
+        mcts_model::Options options{n_threads};
+        options.seed = rng::stream_seed(0, stream);
+        return options;
+    };
+    auto a_white = mcts_model::make_model(type_a, policy_for(type_a), chess::side::side_white, options_for(1));
+    auto a_black = mcts_model::make_model(type_a, policy_for(type_a), chess::side::side_black, options_for(2));
+    auto b_white = mcts_model::make_model(type_b, policy_for(type_b), chess::side::side_white, options_for(3));
+    auto b_black = mcts_model::make_model(type_b, policy_for(type_b), chess::side::side_black, options_for(4));
+
+    double rate_a = iterations_per_sec(*a_white, 200);
+    double rate_b = iterations_per_sec(*b_white, 200);
+    int iter_a = std::max(1, static_cast<int>(rate_a * ms_per_move / 1000));
+    int iter_b = std::max(1, static_cast<int>(rate_b * ms_per_move / 1000));
+
+    MatchScore score = play_match(*a_white, *a_black, iter_a, *b_white, *b_black, iter_b, games, max_moves);
+
+    std::cout << "model " << type_a << " iterations/sec: " << rate_a << " iterations/move: " << iter_a << std::endl;
+    std::cout << "model " << type_b << " iterations/sec: " << rate_b << " iterations/move: " << iter_b << std::endl;
+    std::cout << "model " << type_a << " vs model " << type_b << " w/d/l: " << score.to_string() << std::endl;
+    return 0;
+}
+
+// Throughput of every selection policy of the arena model and its score against UCB1 at equal wall time per move
+int bench_selection(int argc, char* argv[])
+{
+    int games = argc > 2 ? std::stoi(argv[2]) : 10;
+    double ms_per_move = argc > 3 ? std::stod(argv[3]) : 100;
+    int max_moves = 100;
+    const char* names[] = {"ucb1", "ucb1-tuned", "puct", "rave"};
+
+    auto policy = std::bind(policy::rollout::fast_rollout, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, 10);
+    auto options_for = [](int selection, std::uint64_t stream)
+    {
+        mcts_model::Options options{};
+        options.selection = selection;
+        options.seed = rng::stream_seed(0, stream);
+        return options;
+    };
+    auto ucb1_white = mcts_model::make_arena_model(policy, chess::side::side_white, options_for(selection::ucb1, 1));
+    auto ucb1_black = mcts_model::make_arena_model(policy, chess::side::side_black, options_for(selection::ucb1, 2));
+    double ucb1_rate = iterations_per_sec(*ucb1_white, 200);
+    int ucb1_iter = std::max(1, static_cast<int>(ucb1_rate * ms_per_move / 1000));
+
+    for(int type : {selection::ucb1, selection::ucb1_tuned, selection::puct, selection::rave})
+    {
+        auto white = mcts_model::make_arena_model(policy, chess::side::side_white, options_for(type, 3));
+        auto black = mcts_model::make_arena_model(policy, chess::side::side_black, options_for(type, 4));
+        double rate = iterations_per_sec(*white, 200);
+        int iter = std::max(1, static_cast<int>(rate * ms_per_move / 1000));
+        MatchScore score = play_match(*white, *black, iter, *ucb1_white, *ucb1_black, ucb1_iter, games, max_moves);
+        std::cout << "selection: " << names[type] << " iterations/sec: " << rate << " vs ucb1 w/d/l: " << score.to_string() << std::endl;
+    }
+    return 0;
+}
+
+// Playouts/sec of heuristic rollout variants and their score against fast_rollout at equal wall time per move
+// Both sides search with the arena model, each gets as many iterations per move as it manages in MS_PER_MOVE
+int bench_heuristic(int argc, char* argv[])
+{
+    int games = argc > 2 ? std::stoi(argv[2]) : 10;
+    double ms_per_move = argc > 3 ? std::stod(argv[3]) : 100;
+    int playouts = argc > 4 ? std::stoi(argv[4]) : 2000;
+    int max_moves = 100;
+    chess::position state = chess::position::from_fen(chess::position::fen_start);
+
+    std::vector<std::pair<std::string, policy::rollout::HeuristicWeights>> variants{};
+    variants.emplace_back("capture x4", policy::rollout::HeuristicWeights{4.0, false, 0, 400.0});
+    variants.emplace_back("mvv-lva x4", policy::rollout::HeuristicWeights{4.0, true, 0, 400.0});
+    variants.emplace_back("mvv-lva x4 cutoff 8", policy::rollout::HeuristicWeights{4.0, true, 8, 400.0});
+    variants.emplace_back("mvv-lva x4 cutoff 16", policy::rollout::HeuristicWeights{4.0, true, 16, 400.0});
+    variants.emplace_back("uniform cutoff 16", policy::rollout::HeuristicWeights{1.0, false, 16, 400.0});
+
+    auto options_for = [](std::uint64_t stream)
+    {
+        mcts_model::Options options{};
+        options.seed = rng::stream_seed(0, stream);
+        return options;
+    };
+    policy::rollout::FastRollout fast_policy{10};
+    auto random_white = mcts_model::make_arena_model(fast_policy, chess::side::side_white, options_for(1));
+    auto random_black = mcts_model::make_arena_model(fast_policy, chess::side::side_black, options_for(2));
+    double random_rate = iterations_per_sec(*random_white, 200);
+    int random_iter = std::max(1, static_cast<int>(random_rate * ms_per_move / 1000));
+
+    double t{0};
+    node::Playout playout{};
+    Timer timer{};
+    t += policy::rollout::fast_rollout(state, chess::side::side_white, playout, playouts);
+    std::cout << "rollout: random playouts/sec: " << playouts / timer.get_time() << " iterations/sec: " << random_rate << std::endl;
+
+    for(auto& [name, weights] : variants)
+    {
+        playout.generator.seed(0);
+        timer.set_start();
+        t += policy::rollout::heuristic_rollout(state, chess::side::side_white, playout, weights, playouts);
+        double playout_rate = playouts / timer.get_time();
+
+        policy::rollout::HeuristicRollout heuristic_policy{10, weights};
+        auto white = mcts_model::make_arena_model(heuristic_policy, chess::side::side_white, options_for(3));
+        auto black = mcts_model::make_arena_model(heuristic_policy, chess::side::side_black, options_for(4));
+        double rate = iterations_per_sec(*white, 200);
+        int iter = std::max(1, static_cast<int>(rate * ms_per_move / 1000));
+        MatchScore score = play_match(*white, *black, iter, *random_white, *random_black, random_iter, games, max_moves);
+        std::cout << "rollout: " << name << " playouts/sec: " << playout_rate << " iterations/sec: " << rate << " vs random w/d/l: " << score.to_string() << std::endl;
+    }
+    std::cout << "(score checksum " << t << ")" << std::endl;
+    return 0;
+}
+
+// Won endgames for bench_solver, white to move and mate
+const std::vector<std::pair<std::string, std::string>> MATE_POSITIONS{
+    {"back_rank", "6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1"},
+    {"kq_vs_k", "4k3/8/8/8/8/8/8/3QK3 w - - 0 1"},
+    {"krr_vs_k", "3K4/8/8/8/8/6R1/7R/3k4 w - - 0 1"}
+};
+
+// Time to mate of TimedModel with and without the solver in the mate positions, GAMES games with their own seeds each
+// Both sides search MCTS_ITER iterations per move, games that last MAX_MOVES white moves count as not mated
+// Prints mated games, white moves until mate, milliseconds of white searches per game and how many of them ended on a proven root
+int bench_solver(int argc, char* argv[])
+{
+    int iterations = argc > 2 ? std::stoi(argv[2]) : 20000;
+    int games = argc > 3 ? std::stoi(argv[3]) : 4;
+    int max_moves = argc > 4 ? std::stoi(argv[4]) : 50;
+    std::cout << "position\tsearch\tmated\tmoves to mate\tms/game\tproven searches" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    for(const auto& [name, fen] : MATE_POSITIONS)
+    {
+        for(bool solver : {false, true})
+        {
+            int mates{0}, moves{0}, proven{0}, searches{0};
+            double milliseconds{0};
+            for(int game = 1 ; game <= games ; ++game)
+            {
+                mcts_model::BasicTimedModel<policy::rollout::FastRollout> white{policy::rollout::FastRollout{10}, chess::side::side_white, rng::stream_seed(game, 1), 0, solver};
+                mcts_model::BasicTimedModel<policy::rollout::FastRollout> black{policy::rollout::FastRollout{10}, chess::side::side_black, rng::stream_seed(game, 2), 0, solver};
+                chess::position game_board = chess::position::from_fen(fen);
+                for(int move = 1 ; move <= max_moves ; ++move)
+                {
+                    game_board.make_move(white.search(game_board, iterations));
+                    milliseconds += white.last_usage.milliseconds;
+                    proven += white.last_usage.proven;
+                    ++searches;
+                    if(game_board.is_checkmate())
+                    {
+                        ++mates;
+                        moves += move;
+                        break;
+                    }
+                    if(game_board.is_stalemate()) break;
+                    game_board.make_move(black.search(game_board, iterations));
+                    if(game_board.is_checkmate() || game_board.is_stalemate()) break;
+                }
+            }
+            std::cout << name << '\t' << (solver ? "solver" : "plain") << '\t' << mates << '/' << games << '\t' << (mates ? double(moves) / mates : 0.0)
+                << '\t' << milliseconds / games << '\t' << proven << '/' << searches << std::endl;
+        }
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,277 @@
+// Per step costs of selection, backpropagation, rollouts and leaf evaluation
+#include "bench.hpp"
+
+// Playouts/sec and heap allocations per playout of the random rollout kernels
+int bench_rollout(int argc, char* argv[])
+{
+    int playouts = argc > 2 ? std::stoi(argv[2]) : 2000;
+    chess::position state = chess::position::from_fen(chess::position::fen_start);
+    double t{0};
+
+    node::Playout playout{};
+    long start_allocations = instrument::allocations.load();
+    Timer timer{};
+    t += policy::rollout::random_rollout(state, chess::side::side_white, playout, playouts);
+    double elapsed = timer.get_time();
+    std::cout << "random_rollout playouts/sec: " << playouts / elapsed << " allocations/playout: " << double(instrument::allocations.load() - start_allocations) / playouts << std::endl;
+
+    playout.generator.seed(0);
+    start_allocations = instrument::allocations.load();
+    timer.set_start();
+    t += policy::rollout::fast_rollout(state, chess::side::side_white, playout, playouts);
+    elapsed = timer.get_time();
+    std::cout << "fast_rollout playouts/sec: " << playouts / elapsed << " allocations/playout: " << double(instrument::allocations.load() - start_allocations) / playouts << std::endl;
+    std::cout << "(score checksum " << t << ")" << std::endl;
+    return 0;
+}
+
+// Playouts/sec of the batched rollout engine against scalar playouts, SIMULATIONS games per leaf in both
+// Every batch holds K copies of the start position, the games of a leaf share their first move generation
+int bench_batch(int argc, char* argv[])
+{
+    int playouts = argc > 2 ? std::stoi(argv[2]) : 2048;
+    int simulations = argc > 3 ? std::max(std::stoi(argv[3]), 1) : 10;
+    chess::position state = chess::position::from_fen(chess::position::fen_start);
+    double t{0};
+
+    node::Playout playout{};
+    int leaves_per_run = std::max(1, playouts / simulations);
+    Timer timer{};
+    for(int i = 0 ; i < leaves_per_run ; ++i) t += policy::rollout::fast_rollout(state, chess::side::side_white, playout, simulations);
+    double scalar = leaves_per_run * simulations / timer.get_time();
+    std::cout << "scalar playouts/sec: " << scalar << std::endl;
+
+    for(size_t batch_size : {8, 32, 128})
+    {
+        policy::rollout::BatchRollout batch_rollout{simulations};
+        std::vector<chess::position> leaves(batch_size, state);
+        std::vector<double> scores{};
+        playout.generator.seed(0);
+        int batches = std::max(1, leaves_per_run / static_cast<int>(batch_size));
+        timer.set_start();
+        for(int i = 0 ; i < batches ; ++i)
+        {
+            batch_rollout(leaves, chess::side::side_white, playout, scores);
+            for(double score : scores) t += score;
+        }
+        double batched = batches * batch_size * simulations / timer.get_time();
+        std::cout << "K=" << batch_size << " playouts/sec: " << batched << " vs scalar: " << batched / scalar << std::endl;
+    }
+    std::cout << "(score checksum " << t << ")" << std::endl;
+    return 0;
+}
+
+// Nanoseconds per selected level at 20, 40 and 80 children
+// The per child path builds a score vector and takes log N for every child like the old Node::traverse
+int bench_select(int argc, char* argv[])
+{
+    int levels = argc > 2 ? std::stoi(argv[2]) : 1000000;
+    rng::Xoshiro256 generator(0);
+    size_t checksum{0};
+
+    for(size_t n_children : {20, 40, 80})
+    {
+        selection::ChildStats stats{};
+        stats.resize(n_children);
+        int parent_n{0};
+        for(size_t i = 0 ; i < n_children ; ++i)
+        {
+            stats.n[i] = 1 + generator.bounded(100);
+            stats.t[i] = static_cast<double>(generator.bounded(201)) - 100.0;
+            stats.blocked[i] = generator.bounded(10) == 0;
+            parent_n += static_cast<int>(stats.n[i]);
+        }
+
+        Timer timer{};
+        for(int level = 0 ; level < levels ; ++level)
+        {
+            std::vector<double> scores{};
+            for(size_t i = 0 ; i < n_children ; ++i)
+            {
+                if(!stats.blocked[i]) scores.push_back(stats.t[i] / stats.n[i] + node::Node::UCB1_CONST * sqrt(log(parent_n + level % 2) / stats.n[i]));
+            }
+            checksum += get_max_idx(scores.begin(), scores.end());
+        }
+        double per_child = timer.get_time() * 1e9 / levels;
+
+        timer.set_start();
+        for(int level = 0 ; level < levels ; ++level)
+        {
+            checksum += selection::best_ucb1(stats, parent_n + level % 2, node::Node::UCB1_CONST);
+        }
+        double cached = timer.get_time() * 1e9 / levels;
+        std::cout << "children: " << n_children << " per child ns/level: " << per_child << " cached log ns/level: " << cached << " speedup: " << per_child / cached << std::endl;
+    }
+    std::cout << "(index checksum " << checksum << ")" << std::endl;
+    return 0;
+}
+
+// Node of the old node::Node::backpropagate, which recursed through weak parent pointers
+// and added the score of the leaf unchanged at every level
+struct RecursiveNode
+{
+    void backpropagate(double score)
+    {
+        if(auto p = parent.lock())
+        {
+            p->t += score;
+            p->n++;
+            p->backpropagate(score);
+        }
+    }
+
+    std::weak_ptr<RecursiveNode> parent{};
+    double t{0};
+    int n{0};
+};
+
+// Nanoseconds per backpropagation against the depth of the updated path
+// recursive locks the parent of every level like the old Node::backpropagate
+// path walks the selected path of node::Node, arena updates an arena::Tree path, both with relaxed atomics and negamax signs
+int bench_backprop(int argc, char* argv[])
+{
+    int updates = argc > 2 ? std::stoi(argv[2]) : 1000000;
+    chess::position state = chess::position::from_fen(chess::position::fen_start);
+    double checksum{0};
+
+    for(size_t depth : {1, 2, 4, 8, 16, 32, 64})
+    {
+        std::shared_ptr<node::Node> main_node{std::make_shared<node::Node>(state, chess::side::side_white)};
+        node::Node::Path path{main_node.get()};
+        std::shared_ptr<node::Node> current_node{main_node};
+        while(path.size() <= depth)
+        {
+            current_node->expand();
+            if(!current_node->has_untried_moves()) break;
+            current_node = current_node->widen(path);
+        }
+
+        // Paths stop early at the end of a game, every layout gets the same depth
+        size_t levels = path.size() - 1;
+        std::vector<std::shared_ptr<RecursiveNode>> chain{std::make_shared<RecursiveNode>()};
+        for(size_t i = 0 ; i < levels ; ++i)
+        {
+            chain.push_back(std::make_shared<RecursiveNode>());
+            chain.back()->parent = chain[i];
+        }
+
+        arena::Tree tree{chess::side::side_white, 0};
+        arena::Cursor cursor{};
+        tree.start(cursor, state);
+        while(cursor.path.size() <= levels && tree[cursor.path.back()].has_children())
+        {
+            tree.descend(cursor, tree[cursor.path.back()].first_child);
+            tree.expand(cursor);
+        }
+
+        Timer timer{};
+        for(int i = 0 ; i < updates ; ++i) chain.back()->backpropagate(i & 1 ? 1.0 : -1.0);
+        double recursive = timer.get_time() * 1e9 / updates;
+
+        timer.set_start();
+        for(int i = 0 ; i < updates ; ++i) node::Node::backpropagate(path, i & 1 ? 1.0 : -1.0);
+        double walked = timer.get_time() * 1e9 / updates;
+
+        timer.set_start();
+        for(int i = 0 ; i < updates ; ++i) tree.update(cursor, i & 1 ? 1.0 : -1.0);
+        double arena_walked = timer.get_time() * 1e9 / updates;
+
+        checksum += chain.front()->t + main_node->get_t() + tree[arena::Tree::root].t.load();
+        std::cout << "depth: " << levels << " recursive ns: " << recursive << " path ns: " << walked << " arena ns: " << arena_walked
+            << " per level: " << recursive / levels << ' ' << walked / levels << ' ' << arena_walked / levels << std::endl;
+    }
+    std::cout << "(score checksum " << checksum << ")" << std::endl;
+    return 0;
+}
+
+// Per iteration cost of TimedModel with the rollout policy dispatched statically, through std::function
+// and through a std::function copied on every rollout together with an mt19937, as Node::rollout used to
+// Rollouts play one game so the dispatch overhead is not hidden behind long playouts
+// The overhead is taken from the rollout step, the only step the policy takes part in
+int bench_policy(int argc, char* argv[])
+{
+    int iterations = argc > 2 ? std::stoi(argv[2]) : 20000;
+    int searches = argc > 3 ? std::stoi(argv[3]) : 5;
+    chess::position state = chess::position::from_fen(chess::position::fen_start);
+    policy::rollout::FastRollout fast_rollout{1};
+    node::policy_function_type copied_policy{[generator = std::mt19937{}, fast_rollout](const chess::position& leaf, chess::side player_side, node::Playout& playout) mutable
+    {
+        generator.discard(1);
+        return fast_rollout(leaf, player_side, playout);
+    }};
+
+    std::vector<std::pair<std::string, std::unique_ptr<mcts_model::TimedModelBase>>> models{};
+    models.emplace_back("static", std::make_unique<mcts_model::BasicTimedModel<policy::rollout::FastRollout>>(fast_rollout, chess::side::side_white));
+    models.emplace_back("std::function", std::make_unique<mcts_model::TimedModel>(fast_rollout, chess::side::side_white));
+    models.emplace_back("copied per call", std::make_unique<mcts_model::TimedModel>([copied_policy](const chess::position& leaf, chess::side player_side, node::Playout& playout)
+    {
+        node::policy_function_type copy{copied_policy};
+        return copy(leaf, player_side, playout);
+    }, chess::side::side_white));
+
+    double static_us{0};
+    for(auto& [name, model] : models)
+    {
+        for(int i = 0 ; i < searches ; ++i) model->search(state, iterations);
+        double total_us = model->total_stats.seconds * 1e6 / (double(iterations) * searches);
+        double rollout_us = model->total_stats.phase_seconds(instrument::rollout_phase) * 1e6 / (double(iterations) * searches);
+        if(name == "static") static_us = rollout_us;
+        std::cout << "policy: " << name << " us/iteration: " << total_us << " rollout us/iteration: " << rollout_us << " rollout overhead vs static us/iteration: " << rollout_us - static_us << std::endl;
+    }
+    return 0;
+}
+
+// BatchRollout that takes LATENCY_US longer per batch, like a batched value function behind a queue
+node::batch_policy_function_type slow_batch_rollout(int simulations, int latency_us)
+{
+    return [rollout = policy::rollout::BatchRollout{simulations}, latency_us](const std::vector<chess::position>& states, chess::side side, node::Playout& playout, std::vector<double>& scores) mutable
+    {
+        rollout(states, side, playout, scores);
+        if(latency_us > 0) std::this_thread::sleep_for(std::chrono::microseconds(latency_us));
+    };
+}
+
+// Leaves/sec of ArenaModel searches of the start position for batch sizes and evaluator queue depths
+// sync rolls every batch out in the search thread, the depths keep that many leaves in flight at a BatchEvaluator
+// with WORKERS worker threads at every depth, so the rows of a batch size only differ in how many batches wait
+// Every batch costs LATENCY_US more, which a deeper queue hides by selecting and evaluating the next batches meanwhile
+int bench_evaluator(int argc, char* argv[])
+{
+    int iterations = argc > 2 ? std::stoi(argv[2]) : 20000;
+    int latency_us = argc > 3 ? std::stoi(argv[3]) : 200;
+    int workers = argc > 4 ? std::max(std::stoi(argv[4]), 1) : 1;
+    int simulations = 1;
+    chess::position state = chess::position::from_fen(chess::position::fen_start);
+    std::cout << "# evaluator iterations=" << iterations << " latency_us=" << latency_us << " workers=" << workers << std::endl;
+    std::cout << "batch\tdepth\tleaves/sec\tavg batch\tbest move" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    for(int batch_size : {1, 8, 32, 128})
+    {
+        mcts_model::Options options{};
+        options.seed = 1;
+        // A batch of one is rolled out by the rollout policy, depth 1 is its synchronous case
+        if(batch_size > 1)
+        {
+            options.batch_size = batch_size;
+            mcts_model::ArenaModel sync_model{policy::rollout::FastRollout{simulations}, state.get_turn(), options};
+            sync_model.set_batch_policy(slow_batch_rollout(simulations, latency_us));
+            Timer timer{};
+            chess::move best_move = sync_model.search(state, iterations);
+            std::cout << batch_size << "\tsync\t" << iterations / timer.get_time() << '\t' << double(batch_size) << '\t' << best_move.to_lan() << std::endl;
+        }
+
+        for(int depth : {batch_size, 2 * batch_size, 4 * batch_size})
+        {
+            options.batch_size = 1;
+            mcts_model::ArenaModel model{policy::rollout::FastRollout{simulations}, state.get_turn(), options};
+            auto leaf_evaluator = std::make_shared<evaluator::BatchEvaluator>(policy::rollout::BatchRollout{simulations}, state.get_turn(), batch_size, workers, latency_us, 1);
+            model.set_evaluator(leaf_evaluator, static_cast<size_t>(depth));
+            Timer timer{};
+            chess::move best_move = model.search(state, iterations);
+            double seconds = timer.get_time();
+            std::cout << batch_size << '\t' << depth << '\t' << leaf_evaluator->evaluated() / seconds << '\t'
+                << double(leaf_evaluator->evaluated()) / std::max<std::uint64_t>(leaf_evaluator->batches(), 1) << '\t' << best_move.to_lan() << std::endl;
+        }
+    }
+    return 0;
+}
\ No newline at end of file
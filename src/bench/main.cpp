@@ -0,0 +1,47 @@
+// Count heap allocations so benchmarks can report them
+#define MCTS_COUNT_ALLOCATIONS
+#include "bench.hpp"
+
+// Usage: ./bench tree <node|arena|compact> [MCTS_ITER] [SEARCHES]
+//        ./bench threads [MCTS_ITER] [MAX_THREADS]
+//        ./bench match <MODEL_A> <MODEL_B> [GAMES] [MS_PER_MOVE] [THREADS]
+//        ./bench rollout [PLAYOUTS]
+//        ./bench batch [PLAYOUTS] [SIMULATIONS]
+//        ./bench select [LEVELS]
+//        ./bench selection [GAMES] [MS_PER_MOVE]
+//        ./bench policy [MCTS_ITER] [SEARCHES]
+//        ./bench heuristic [GAMES] [MS_PER_MOVE] [PLAYOUTS]
+//        ./bench suite [MCTS_ITER] [SEARCHES] [MODEL] [THREADS]
+//        ./bench backprop [UPDATES]
+//        ./bench expand [MCTS_ITER]
+//        ./bench cache [MCTS_ITER] [SEARCHES] [CACHE_VISITS]
+//        ./bench memory [MCTS_ITER] [LIMIT_KB]
+//        ./bench snapshot [MCTS_ITER]
+//        ./bench evaluator [MCTS_ITER] [LATENCY_US] [WORKERS]
+//        ./bench solver [MCTS_ITER] [GAMES] [MAX_MOVES]
+// Run one layout per process so the reported peak RSS belongs to that layout only
+
+int main(int argc, char* argv[])
+{
+    chess::init();
+    std::string benchmark{argc > 1 ? argv[1] : "tree"};
+    if(benchmark == "tree") return bench_tree(argc, argv);
+    if(benchmark == "threads") return bench_threads(argc, argv);
+    if(benchmark == "match") return bench_match(argc, argv);
+    if(benchmark == "rollout") return bench_rollout(argc, argv);
+    if(benchmark == "batch") return bench_batch(argc, argv);
+    if(benchmark == "select") return bench_select(argc, argv);
+    if(benchmark == "selection") return bench_selection(argc, argv);
+    if(benchmark == "policy") return bench_policy(argc, argv);
+    if(benchmark == "heuristic") return bench_heuristic(argc, argv);
+    if(benchmark == "suite") return bench_suite(argc, argv);
+    if(benchmark == "backprop") return bench_backprop(argc, argv);
+    if(benchmark == "expand") return bench_expand(argc, argv);
+    if(benchmark == "cache") return bench_cache(argc, argv);
+    if(benchmark == "memory") return bench_memory(argc, argv);
+    if(benchmark == "snapshot") return bench_snapshot(argc, argv);
+    if(benchmark == "evaluator") return bench_evaluator(argc, argv);
+    if(benchmark == "solver") return bench_solver(argc, argv);
+    std::cerr << "unknown benchmark " << benchmark << std::endl;
+    return 1;
+}
\ No newline at end of file
@@ -0,0 +1,122 @@
+// Fixed positions searched with fixed seeds, so runs of two builds can be compared
+#include "bench.hpp"
+
+extern const std::vector<std::pair<std::string, std::string>> SUITE_POSITIONS{
+    {"start", chess::position::fen_start},
+    {"italian", "r1bqkbnr/pppp1ppp/2n5/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R b KQkq - 3 3"},
+    {"sicilian", "rnbqkbnr/pp1ppppp/8/2p5/4P3/5N2/PPPP1PPP/RNBQKB1R b KQkq - 1 2"},
+    {"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"},
+    {"cpw4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1"},
+    {"cpw6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10"},
+    {"cpw3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"},
+    {"kp_vs_k", "8/8/8/4k3/8/8/4P3/4K3 w - - 0 1"},
+    {"krr_vs_k", "3K4/8/8/8/8/6R1/7R/3k4 w - - 0 1"}
+};
+
+// Search every suite position SEARCHES times, each with its own fixed seed
+// Prints one tab separated line per position, so runs of two builds can be diffed
+// The first four columns are reproducible with one thread, the rates after them vary from run to run
+// Stability is the share of searches that picked the most common best move
+// tree_kb is the largest tree of the searches of the position, the process peak would only ever grow
+int bench_suite(int argc, char* argv[])
+{
+    int iterations = argc > 2 ? std::stoi(argv[2]) : 2000;
+    int searches = argc > 3 ? std::stoi(argv[3]) : 5;
+    int type = argc > 4 ? std::stoi(argv[4]) : mcts_model::arena_model;
+    int n_threads = argc > 5 ? std::stoi(argv[5]) : 1;
+    int simulations = 10;
+    int n_iter = type == mcts_model::leaf_parallel_model ? (simulations + n_threads - 1) / n_threads : simulations;
+
+    std::cout << "# suite model=" << type << " threads=" << n_threads << " iterations=" << iterations << " searches=" << searches << " simulations=" << simulations << std::endl;
+    std::cout << "position\tbest_move\tstability\ttree_kb\titerations/sec\tplayouts/sec\tnodes/sec" << std::endl;
+    std::cout << std::fixed << std::setprecision(0);
+    for(const auto& [name, fen] : SUITE_POSITIONS)
+    {
+        chess::position state = chess::position::from_fen(fen);
+        std::map<std::string, int> best_moves{};
+        double seconds{0};
+        long total_iterations{0};
+        size_t total_nodes{0};
+        size_t tree_bytes{0};
+        for(int search = 0 ; search < searches ; ++search)
+        {
+            mcts_model::Options options{n_threads};
+            options.seed = rng::stream_seed(0, search);
+            auto model = mcts_model::make_model(type, policy::rollout::FastRollout{n_iter}, state.get_turn(), options);
+            Timer timer{};
+            chess::move best_move = model->search(state, iterations);
+            seconds += timer.get_time();
+            total_iterations += model->last_usage.iterations;
+            total_nodes += model->last_usage.nodes;
+            tree_bytes = std::max(tree_bytes, model->last_usage.bytes);
+            if(auto arena_model = dynamic_cast<mcts_model::ArenaModelBase*>(model.get())) tree_bytes = std::max(tree_bytes, arena_model->last_tree_bytes);
+            ++best_moves[best_move.to_lan()];
+        }
+        auto most_common = std::max_element(best_moves.begin(), best_moves.end(), [](const auto& a, const auto& b) { return a.second < b.second; });
+        std::cout << name << '\t' << most_common->first << '\t' << std::setprecision(2) << most_common->second / double(searches) << std::setprecision(0)
+            << '\t' << tree_bytes / 1024 << '\t' << total_iterations / seconds << '\t' << total_iterations * simulations / seconds << '\t' << total_nodes / seconds << std::endl;
+    }
+    return 0;
+}
+
+// Cache file of bench_cache, removed before and after the benchmark
+const char* BENCH_STATS_CACHE = "bench_stats_cache.bin";
+
+// How often SEARCHES arena searches of state with seeds 1 to SEARCHES pick reference, and their milliseconds
+std::pair<int, double> cached_searches(const chess::position& state, int iterations, int searches, const std::string& reference, const mcts_model::Options& cache_options)
+{
+    int agreement{0};
+    Timer timer{};
+    for(int search = 1 ; search <= searches ; ++search)
+    {
+        mcts_model::Options options = cache_options;
+        options.seed = rng::stream_seed(0, search);
+        mcts_model::ArenaModel model{policy::rollout::FastRollout{10}, state.get_turn(), options};
+        agreement += model.search(state, iterations).to_lan() == reference;
+    }
+    return {agreement, timer.get_time() * 1000.0 / searches};
+}
+
+// Best move agreement with a search of 20 times the iterations in the opening positions, searching cold and with a warm stats cache
+// SEARCHES earlier searches with other seeds fill the cache first, like earlier games of a match would
+int bench_cache(int argc, char* argv[])
+{
+    int iterations = argc > 2 ? std::stoi(argv[2]) : 500;
+    int searches = argc > 3 ? std::stoi(argv[3]) : 10;
+    int cache_visits = argc > 4 ? std::stoi(argv[4]) : iterations;
+    std::remove(BENCH_STATS_CACHE);
+    mcts_model::Options warm_options{};
+    warm_options.stats_cache = std::make_shared<stats_cache::Cache>(BENCH_STATS_CACHE);
+    warm_options.stats_cache_visits = cache_visits;
+    if(!warm_options.stats_cache->is_open())
+    {
+        std::cerr << "cannot map " << BENCH_STATS_CACHE << std::endl;
+        return 1;
+    }
+    std::cout << std::fixed << std::setprecision(2);
+    for(size_t i = 0 ; i < 3 ; ++i)
+    {
+        const auto& [name, fen] = SUITE_POSITIONS[i];
+        chess::position state = chess::position::from_fen(fen);
+        mcts_model::Options reference_options{};
+        reference_options.seed = rng::stream_seed(1, 0);
+        mcts_model::ArenaModel reference_model{policy::rollout::FastRollout{10}, state.get_turn(), reference_options};
+        std::string reference = reference_model.search(state, 20 * iterations).to_lan();
+
+        auto [cold_agreement, cold_ms] = cached_searches(state, iterations, searches, reference, mcts_model::Options{});
+        for(int search = 1 ; search <= searches ; ++search)
+        {
+            mcts_model::Options options = warm_options;
+            options.seed = rng::stream_seed(2, search);
+            mcts_model::ArenaModel model{policy::rollout::FastRollout{10}, state.get_turn(), options};
+            model.search(state, iterations);
+        }
+        auto [warm_agreement, warm_ms] = cached_searches(state, iterations, searches, reference, warm_options);
+        std::cout << name << ": reference " << reference << " agreement " << cold_agreement << '/' << searches << " -> " << warm_agreement << '/' << searches
+            << " ms/search " << cold_ms << " -> " << warm_ms << std::endl;
+    }
+    std::cout << "cached positions: " << warm_options.stats_cache->size() << std::endl;
+    warm_options.stats_cache.reset();
+    std::remove(BENCH_STATS_CACHE);
+    return 0;
+}
\ No newline at end of file
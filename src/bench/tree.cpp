@@ -0,0 +1,210 @@
+// Layout, memory and persistence of the search trees
+#include "bench.hpp"
+
+// Iterations/sec and peak RSS of repeated searches from the start position
+int bench_tree(int argc, char* argv[])
+{
+    std::string layout{argc > 2 ? argv[2] : "arena"};
+    int iterations = argc > 3 ? std::stoi(argv[3]) : 2000;
+    int searches = argc > 4 ? std::stoi(argv[4]) : 5;
+
+    auto policy = std::bind(policy::rollout::random_rollout, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, 1);
+    chess::position state = chess::position::from_fen(chess::position::fen_start);
+
+    // arena stores every position like node::Node does, compact only caches often visited ones
+    std::unique_ptr<mcts_model::Model> model;
+    if(layout == "node") model = std::make_unique<mcts_model::Model>(policy, chess::side::side_white);
+    else if(layout == "arena") model = std::make_unique<mcts_model::ArenaModel>(policy, chess::side::side_white, mcts_model::Options{1, 0});
+    else model = std::make_unique<mcts_model::ArenaModel>(policy, chess::side::side_white);
+
+    Timer timer{};
+    for(int i = 0 ; i < searches ; ++i)
+    {
+        model->search(state, iterations);
+    }
+    double elapsed = timer.get_time();
+
+    std::cout << "layout: " << layout << std::endl;
+    std::cout << "iterations/sec: " << iterations * searches / elapsed << std::endl;
+    std::cout << "peak RSS (kB): " << peak_rss_kb() << std::endl;
+    if(auto arena_model = dynamic_cast<mcts_model::ArenaModelBase*>(model.get()))
+    {
+        std::cout << arena_model->last_memory_report << std::endl;
+    }
+    return 0;
+}
+
+// Iterations/sec of the tree parallel search from 1 thread up to every core
+int bench_threads(int argc, char* argv[])
+{
+    int iterations = argc > 2 ? std::stoi(argv[2]) : 20000;
+    int max_threads = argc > 3 ? std::stoi(argv[3]) : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+    auto policy = std::bind(policy::rollout::random_rollout, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, 1);
+    chess::position state = chess::position::from_fen(chess::position::fen_start);
+
+    double single_thread{0};
+    for(int n_threads = 1 ; n_threads <= max_threads ; n_threads = n_threads < max_threads ? std::min(n_threads * 2, max_threads) : n_threads + 1)
+    {
+        mcts_model::ParallelModel model{policy, chess::side::side_white, mcts_model::Options{n_threads}};
+        Timer timer{};
+        model.search(state, iterations);
+        double per_sec = iterations / timer.get_time();
+        if(n_threads == 1) single_thread = per_sec;
+        std::cout << "threads: " << n_threads << " iterations/sec: " << per_sec << " speedup: " << per_sec / single_thread << std::endl;
+    }
+    return 0;
+}
+
+// Nodes in the subtree of current_node
+size_t count_nodes(const node::Node& current_node)
+{
+    size_t count = 1;
+    for(const std::shared_ptr<node::Node>& child : current_node.get_children()) count += count_nodes(*child);
+    return count;
+}
+
+// Nodes, bytes and time spent selecting and expanding of one search
+struct ExpansionRun
+{
+    size_t nodes{0};
+    size_t bytes{0};
+    double tree_seconds{0};
+    std::string best_move{};
+};
+
+// Search state like TimedModel with single game rollouts and a fixed seed
+// eager makes a child of every move as soon as a node is expanded and checks each for mate and stalemate,
+// like Node::expand used to, lazy lets selection create one child at a time
+// Both grow the same tree, as UCB1 picks children without visits in move order
+ExpansionRun run_expansion(const chess::position& state, int iterations, bool eager)
+{
+    ExpansionRun run{};
+    policy::rollout::FastRollout rollout{1};
+    node::Playout playout{};
+    playout.generator.seed(0);
+    std::shared_ptr<node::Node> main_node{std::make_shared<node::Node>(state, state.get_turn())};
+    node::Node::Path path{main_node.get()};
+    size_t terminal_children{0};
+    auto expand = [&](node::Node& current_node)
+    {
+        current_node.expand();
+        if(!eager) return;
+        while(current_node.has_untried_moves())
+        {
+            std::shared_ptr<node::Node> child = current_node.widen(path);
+            path.pop_back();
+            terminal_children += child->get_state().is_checkmate() || child->get_state().is_stalemate();
+        }
+    };
+
+    Timer timer{};
+    expand(*main_node);
+    run.tree_seconds += timer.get_time();
+    for(int i = 0 ; i < iterations ; ++i)
+    {
+        timer.set_start();
+        path.assign(1, main_node.get());
+        std::shared_ptr<node::Node> current_node = main_node->traverse(path);
+        if(current_node->is_over()) break;
+        if(current_node->get_n() != 0)
+        {
+            expand(*current_node);
+            if(current_node->is_over()) continue;
+            current_node = eager ? current_node->traverse(path) : current_node->widen(path);
+        }
+        run.tree_seconds += timer.get_time();
+        node::Node::backpropagate(path, current_node->rollout(rollout, playout));
+    }
+    run.nodes = count_nodes(*main_node);
+    run.bytes = main_node->tree_bytes();
+    run.best_move = main_node->best_move().to_lan() + (terminal_children ? "+" : "");
+    return run;
+}
+
+// Nodes, node memory and selection plus expansion time per iteration of eager against lazy expansion of node::Node
+// The arena tree still allocates every child on expansion and is not measured here
+int bench_expand(int argc, char* argv[])
+{
+    int iterations = argc > 2 ? std::stoi(argv[2]) : 20000;
+    std::cout << std::fixed << std::setprecision(1);
+    for(const auto& [name, fen] : SUITE_POSITIONS)
+    {
+        chess::position state = chess::position::from_fen(fen);
+        ExpansionRun eager = run_expansion(state, iterations, true);
+        ExpansionRun lazy = run_expansion(state, iterations, false);
+        std::cout << name << ": nodes " << eager.nodes << " -> " << lazy.nodes << " (" << eager.nodes / double(lazy.nodes) << "x)"
+            << " node kb " << eager.bytes / 1024.0 << " -> " << lazy.bytes / 1024.0 << " (" << eager.bytes / double(lazy.bytes) << "x)"
+            << " select+expand ns/iteration " << eager.tree_seconds * 1e9 / iterations << " -> " << lazy.tree_seconds * 1e9 / iterations
+            << " (" << eager.tree_seconds / lazy.tree_seconds << "x)"
+            << " best move " << eager.best_move << ' ' << lazy.best_move << std::endl;
+    }
+    return 0;
+}
+
+// Peak tree bytes, prunes, iterations/sec and best move of TimedModel searches of the suite positions, unbounded and under LIMIT_KB
+int bench_memory(int argc, char* argv[])
+{
+    int iterations = argc > 2 ? std::stoi(argv[2]) : 50000;
+    size_t limit_kb = argc > 3 ? std::stoul(argv[3]) : 1024;
+    std::cout << std::fixed << std::setprecision(0);
+    for(const auto& [name, fen] : SUITE_POSITIONS)
+    {
+        chess::position state = chess::position::from_fen(fen);
+        std::string line{name + ":"};
+        for(size_t limit : {size_t{0}, limit_kb * 1024})
+        {
+            mcts_model::BasicTimedModel<policy::rollout::FastRollout> model{policy::rollout::FastRollout{10}, state.get_turn(), 1, limit};
+            Timer timer{};
+            chess::move best_move = model.search(state, iterations);
+            double seconds = timer.get_time();
+            line += (limit ? " -> " : " ") + std::to_string(model.tree_memory.peak_bytes.load() / 1024) + " kb peak, "
+                + std::to_string(model.tree_memory.prunes.load()) + " prunes, " + std::to_string(model.tree_memory.pruned_nodes.load()) + " pruned nodes, "
+                + std::to_string(static_cast<long>(model.last_usage.iterations / seconds)) + " iterations/sec, best move " + best_move.to_lan();
+        }
+        std::cout << line << std::endl;
+    }
+    return 0;
+}
+
+// Snapshot file of bench_snapshot, removed after the benchmark
+const char* BENCH_SNAPSHOT = "bench_tree.bin";
+
+// Nanoseconds per node and MB/s of saving, writing, reading and restoring the arena tree of a search of every suite position
+// The restored tree must pick the same move as the searched one
+int bench_snapshot(int argc, char* argv[])
+{
+    int iterations = argc > 2 ? std::stoi(argv[2]) : 200000;
+    std::cout << std::fixed << std::setprecision(1);
+    for(const auto& [name, fen] : SUITE_POSITIONS)
+    {
+        chess::position state = chess::position::from_fen(fen);
+        mcts_model::Options options{};
+        options.reuse_tree = true;
+        mcts_model::ArenaModel model{policy::rollout::FastRollout{1}, state.get_turn(), options};
+        model.search(state, iterations);
+        std::string best_move = model.tree.best_move().to_lan();
+
+        Timer timer{};
+        snapshot::Snapshot saved = model.tree.save();
+        double save_seconds = timer.get_time(true);
+        snapshot::write(BENCH_SNAPSHOT, saved);
+        double write_seconds = timer.get_time(true);
+        snapshot::Snapshot loaded{};
+        bool read = snapshot::read(BENCH_SNAPSHOT, loaded);
+        double read_seconds = timer.get_time(true);
+        arena::Cursor cursor{};
+        bool restored = read && model.tree.restore(loaded, cursor, state);
+        double restore_seconds = timer.get_time();
+
+        size_t n = saved.nodes.size();
+        double mb = n * sizeof(snapshot::SavedNode) / double(1 << 20);
+        auto per_node = [n](double seconds) { return seconds * 1e9 / n; };
+        std::cout << name << ": " << n << " nodes, " << mb << " MB, ns/node save " << per_node(save_seconds) << " write " << per_node(write_seconds)
+            << " read " << per_node(read_seconds) << " restore " << per_node(restore_seconds)
+            << ", MB/s write " << mb / write_seconds << " read " << mb / read_seconds
+            << ", best move " << best_move << ' ' << (restored ? model.tree.best_move().to_lan() : std::string{"not restored"}) << std::endl;
+    }
+    std::remove(BENCH_SNAPSHOT);
+    return 0;
+}
\ No newline at end of file
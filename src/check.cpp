@@ -0,0 +1,112 @@
+#include <chess/chess.hpp>
+#include <mcts/node.hpp>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Usage: ./check
+// Runs the checks of the node tree and prints one line per check, exits with 1 if one of them fails
+// The positions are real games, so the checks need the chess library, not a stand-in for it
+
+// Rollout policy that scores every position as a draw, the checks only look at the tree
+double draw_rollout(const chess::position&, chess::side, node::Playout&)
+{
+    return 0.0;
+}
+
+// Child of parent reached by the move written as lan, widening parent until it has it, nullptr if the move is not legal
+std::shared_ptr<node::Node> grow(node::Node& parent, const std::string& lan)
+{
+    if(!parent.is_expanded()) parent.expand();
+    for(const std::shared_ptr<node::Node>& child : parent.get_children())
+    {
+        if(child->get_move().to_lan() == lan) return child;
+    }
+    node::Node::Path path{};
+    while(parent.has_untried_moves())
+    {
+        path.assign(1, &parent);
+        std::shared_ptr<node::Node> child = parent.widen(path);
+        if(child->get_move().to_lan() == lan) return child;
+    }
+    return nullptr;
+}
+
+// Node reached from root by the moves of line, nullptr once one of them has no child
+std::shared_ptr<node::Node> find_line(const std::shared_ptr<node::Node>& root, const std::vector<std::string>& line)
+{
+    std::shared_ptr<node::Node> current{root};
+    for(const std::string& lan : line)
+    {
+        std::shared_ptr<node::Node> next{};
+        for(const std::shared_ptr<node::Node>& child : current->get_children())
+        {
+            if(child->get_move().to_lan() == lan) next = child;
+        }
+        if(!next) return nullptr;
+        current = next;
+    }
+    return current;
+}
+
+// Tree after 1. f3 with the line e5 g4 Qh4# below the root, the mate visited once and proven if prove is set
+// The mate sits three levels below the root, so the root child holding it only has a proof two levels down
+std::shared_ptr<node::Node> fools_mate_tree(bool prove)
+{
+    chess::position state = chess::position::from_fen(chess::position::fen_start);
+    for(const chess::move& move : state.moves())
+    {
+        if(move.to_lan() == "f2f3")
+        {
+            state.make_move(move);
+            break;
+        }
+    }
+    auto root = std::make_shared<node::Node>(state, chess::side::side_black);
+    std::shared_ptr<node::Node> current{root};
+    for(const std::string lan : {"e7e5", "g2g4", "d8h4"})
+    {
+        current = grow(*current, lan);
+        if(!current) return nullptr;
+    }
+    node::Playout playout{};
+    current->rollout(draw_rollout, playout, prove);
+    return root;
+}
+
+// Pruning keeps the line to a proven node that lies more than one level below the collapsed candidate
+bool check_prune_keeps_deep_proof()
+{
+    std::shared_ptr<node::Node> root = fools_mate_tree(true);
+    if(!root) return false;
+    root->prune(2);
+    std::shared_ptr<node::Node> mate = find_line(root, {"e7e5", "g2g4", "d8h4"});
+    return mate && mate->is_proven() && mate->get_proof() == node::proven_win;
+}
+
+// Without the solver a mate is terminal but not proven, so pruning collapses the line to it
+bool check_prune_without_solver()
+{
+    std::shared_ptr<node::Node> root = fools_mate_tree(false);
+    if(!root) return false;
+    std::shared_ptr<node::Node> mate = find_line(root, {"e7e5", "g2g4", "d8h4"});
+    if(!mate || mate->is_proven() || !mate->is_over()) return false;
+    root->prune(2);
+    std::shared_ptr<node::Node> reply = find_line(root, {"e7e5"});
+    return reply && reply->get_children().empty();
+}
+
+int main()
+{
+    chess::init();
+    int failed{0};
+    auto run = [&failed](const std::string& name, bool passed)
+    {
+        std::cout << (passed ? "pass " : "FAIL ") << name << std::endl;
+        if(!passed) ++failed;
+    };
+    run("prune keeps deep proof", check_prune_keeps_deep_proof());
+    run("prune without solver", check_prune_without_solver());
+    return failed ? 1 : 0;
+}
\ No newline at end of file
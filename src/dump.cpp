@@ -0,0 +1,97 @@
+#include <chess/chess.hpp>
+#include <mcts/snapshot.hpp>
+#include <mcts/misc.hpp>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+// Usage: ./dump <TREE_FILE> [PV_LENGTH] [TOP_MOVES]
+// Prints the principal variation, the visit distribution of the root moves and the nodes and visits per depth
+// of a tree written by the arena models, e.g. with SAVE_TREE=1
+// Scores are mean scores from the side that played the move
+
+int main(int argc, char* argv[])
+{
+    if(argc < 2)
+    {
+        std::cerr << "usage: ./dump <TREE_FILE> [PV_LENGTH] [TOP_MOVES]" << std::endl;
+        return 1;
+    }
+    std::string tree_file{argv[1]};
+    size_t pv_length = argc > 2 ? std::stoul(argv[2]) : 32;
+    size_t top_moves = argc > 3 ? std::stoul(argv[3]) : 10;
+    chess::init();
+
+    snapshot::Snapshot saved{};
+    Timer timer{};
+    if(!snapshot::read(tree_file, saved))
+    {
+        std::cerr << "cannot read " << tree_file << std::endl;
+        return 1;
+    }
+    double read_seconds = timer.get_time();
+    const std::vector<snapshot::SavedNode>& nodes = saved.nodes;
+    auto mean = [](const snapshot::SavedNode& node) { return node.n ? node.t / node.n : 0.0; };
+
+    // Nodes come in breadth first order, so depths follow parents forwards and subtree sizes children backwards
+    std::vector<std::uint32_t> depth(nodes.size(), 0);
+    std::vector<std::uint64_t> subtree(nodes.size(), 1);
+    for(size_t i = 1 ; i < nodes.size() ; ++i) depth[i] = depth[nodes[i].parent] + 1;
+    for(size_t i = nodes.size() ; i-- > 1 ;) subtree[nodes[i].parent] += subtree[i];
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "nodes: " << nodes.size() << std::endl;
+    std::cout << "root visits: " << nodes[0].n << std::endl;
+    std::cout << "side to move: " << (saved.root_turn == chess::side::side_white ? "white" : "black") << std::endl;
+    std::cout << "read: " << read_seconds * 1000.0 << " ms, " << nodes.size() * sizeof(snapshot::SavedNode) / std::max(read_seconds, 1e-9) / (1 << 20) << " MB/s" << std::endl;
+
+    // The root move is picked by score like the search does, deeper moves by visits
+    std::cout << std::endl << "principal variation:" << std::endl;
+    size_t current = 0;
+    for(size_t ply = 0 ; ply < pv_length && nodes[current].n_children > 0 ; ++ply)
+    {
+        const snapshot::SavedNode& parent = nodes[current];
+        size_t best = parent.first_child;
+        for(size_t i = parent.first_child ; i < parent.first_child + parent.n_children ; ++i)
+        {
+            bool better = current == 0 ? nodes[i].t > nodes[best].t : nodes[i].n > nodes[best].n;
+            if(better) best = i;
+        }
+        if(nodes[best].n == 0) break;
+        std::cout << std::setw(4) << ply + 1 << ' ' << std::setw(8) << nodes[best].move.to_lan() << " visits " << std::setw(10) << nodes[best].n
+            << " score " << std::setw(7) << mean(nodes[best]) << ((nodes[best].flags & snapshot::SavedNode::terminal) ? " terminal" : "") << std::endl;
+        current = best;
+    }
+
+    std::cout << std::endl << "root moves by visits:" << std::endl;
+    const snapshot::SavedNode& root = nodes[0];
+    std::vector<size_t> children{};
+    for(size_t i = root.first_child ; root.n_children > 0 && i < root.first_child + root.n_children ; ++i) children.push_back(i);
+    std::sort(children.begin(), children.end(), [&nodes](size_t a, size_t b) { return nodes[a].n > nodes[b].n; });
+    for(size_t i = 0 ; i < std::min(top_moves, children.size()) ; ++i)
+    {
+        const snapshot::SavedNode& child = nodes[children[i]];
+        std::cout << std::setw(8) << child.move.to_lan() << " visits " << std::setw(10) << child.n
+            << " share " << std::setw(7) << (root.n ? 100.0 * child.n / root.n : 0.0) << "%"
+            << " score " << std::setw(7) << mean(child) << " nodes " << subtree[children[i]] << std::endl;
+    }
+    if(children.size() > top_moves) std::cout << "... " << children.size() - top_moves << " more" << std::endl;
+
+    std::cout << std::endl << "depth\tnodes\tvisits" << std::endl;
+    std::vector<std::uint64_t> depth_nodes{}, depth_visits{};
+    for(size_t i = 0 ; i < nodes.size() ; ++i)
+    {
+        if(depth[i] >= depth_nodes.size())
+        {
+            depth_nodes.resize(depth[i] + 1, 0);
+            depth_visits.resize(depth[i] + 1, 0);
+        }
+        ++depth_nodes[depth[i]];
+        depth_visits[depth[i]] += static_cast<std::uint64_t>(nodes[i].n);
+    }
+    for(size_t d = 0 ; d < depth_nodes.size() ; ++d) std::cout << d << '\t' << depth_nodes[d] << '\t' << depth_visits[d] << std::endl;
+    return 0;
+}
\ No newline at end of file
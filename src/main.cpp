@@ -1,62 +1,116 @@
+// Count heap allocations for the search statistics, unless they are compiled out
+#if !defined(MCTS_INSTRUMENT) || MCTS_INSTRUMENT
+#define MCTS_COUNT_ALLOCATIONS
+#endif
 #include <chess/chess.hpp>
+#include <mcts/instrument.hpp>
 #include <mcts/node.hpp>
 #include <mcts/policy.hpp>
 #include <mcts/mcts_model.hpp>
+#include <mcts/match.hpp>
 #include <iostream>
 #include <string>
 #include <memory>
 #include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <random>
 
-// Usage: ./main MCTS_ITER <config filename>
+// Usage: ./main MCTS_ITER <config filename> [stats cache filename]
 
 int main(int argc, char* argv[])
 {
     std::string config_file_name{"config.txt"};
     if(argc > 1) config_file_name = argv[1];
+    std::string stats_cache_file_name{stats_cache::DEFAULT_FILE};
+    if(argc > 2) stats_cache_file_name = argv[2];
     std::unordered_map<std::string, int> dict = parse_config(config_file_name);
     int MAX_MOVES = dict["MAX_MOVES"];
-    int MAX_MCTS_ITERATIONS = dict["MAX_MCTS_ITERATIONS"];
     int PRINT_TIME = dict["PRINT_TIME"];
-    int ROLLOUT_SIMULATIONS = dict["ROLLOUT_SIMULATIONS"];
     int WIN_SCORE = dict["WIN_SCORE"];
     int DRAW_SCORE = dict["DRAW_SCORE"];
+    int TT_SIZE = dict["TT_SIZE"];
+    int SEED = dict["SEED"];
+    int PRINT_STATS = dict["PRINT_STATS"];
+    int SAVE_TREE = dict["SAVE_TREE"];
+    // Model, rollout policy and search limits
+    match::Settings settings = match::settings_from_config(dict, stats_cache_file_name, parse_config_decimals(config_file_name));
 
     // Initialize engine & set node parameters
     chess::init();
     node::init(WIN_SCORE, DRAW_SCORE, 2.0);
 
-    // Initialize random generator
-    static std::random_device random_device;
-    static std::mt19937 generator(random_device());
-    // Set rollout policy
-    auto policy = std::bind(policy::rollout::random_rollout, std::placeholders::_1, std::placeholders::_2, generator, ROLLOUT_SIMULATIONS);
-
+    // Pick the seed, SEED=0 draws a fresh one that is printed so the game can be replayed
+    std::random_device random_device;
+    std::uint64_t seed = SEED ? static_cast<std::uint64_t>(SEED) : random_device();
+    std::cout << "seed " << seed << std::endl;
     // Initialize MCTS node
     chess::side enemy_side = chess::side::side_black;
     chess::position game_board = chess::position::from_fen(chess::position::fen_start); // Or chess::position::from_fen("3K4/8/8/8/8/6R1/7R/3k4 w - - 0 1")
     
-    // Initialize models to play against each other
-    mcts_model::TimedModel model_1{policy, chess::side::side_white};
-    mcts_model::TimedModel model_2{policy, chess::side::side_black};
+    // Initialize models to play against each other, each with its own random streams
+    // With SAVE_TREE the arena models write the tree of every search to a file per side
+    match::Settings white_settings{settings};
+    match::Settings black_settings{settings};
+    if(SAVE_TREE)
+    {
+        white_settings.options.snapshot_file = "tree_white.bin";
+        black_settings.options.snapshot_file = "tree_black.bin";
+    }
+    std::unique_ptr<mcts_model::Model> model_1{match::make_player(white_settings, chess::side::side_white, rng::stream_seed(seed, 1))};
+    std::unique_ptr<mcts_model::Model> model_2{match::make_player(black_settings, chess::side::side_black, rng::stream_seed(seed, 2))};
     
     
+    // Search limits per move, 0 disables a limit
+    const budget::Limits& limits = settings.limits;
+
     short moves{0};
 
     while(true)
     {
-        chess::move model_1_move{model_1.search(game_board, MAX_MCTS_ITERATIONS)};
+        chess::move model_1_move{model_1->search(game_board, limits)};
+        if(PRINT_STATS) std::cout << "{\"model\":1,\"move\":" << moves << ",\"stats\":" << model_1->last_stats.to_json() << "}" << std::endl;
         game_board.make_move(model_1_move);
+        model_1->advance(model_1_move);
+        model_2->advance(model_1_move);
         if(game_board.is_checkmate() || game_board.is_stalemate()) break;
-        chess::move model_2_move{model_2.search(game_board, MAX_MCTS_ITERATIONS)};
+        chess::move model_2_move{model_2->search(game_board, limits)};
+        if(PRINT_STATS) std::cout << "{\"model\":2,\"move\":" << moves << ",\"stats\":" << model_2->last_stats.to_json() << "}" << std::endl;
         game_board.make_move(model_2_move);
+        model_1->advance(model_2_move);
+        model_2->advance(model_2_move);
         if(game_board.is_checkmate() || game_board.is_stalemate() || moves++ == MAX_MOVES) break; 
         std::cout << "player 1 move " << model_1_move.to_lan() << std::endl;
         std::cout << "player 2 move " << model_2_move.to_lan() << std::endl;
+        std::cout << "player 1 used " << model_1->last_usage.iterations << " iterations, " << model_1->last_usage.milliseconds << " ms, " << model_1->last_usage.nodes << " nodes, " << model_1->last_usage.bytes / 1024 << " kb" << (model_1->last_usage.stopped_early ? ", stopped early" : "") << (model_1->last_usage.proven ? ", proven" : "") << std::endl;
+        std::cout << "player 2 used " << model_2->last_usage.iterations << " iterations, " << model_2->last_usage.milliseconds << " ms, " << model_2->last_usage.nodes << " nodes, " << model_2->last_usage.bytes / 1024 << " kb" << (model_2->last_usage.stopped_early ? ", stopped early" : "") << (model_2->last_usage.proven ? ", proven" : "") << std::endl;
         std::cout << "-- Game state --" << std::endl << game_board.to_string() << std::endl << std::endl;
     }
     
     std::cout << "-- Final state --" << std::endl << game_board.to_string() << std::endl;
-    std::cout << "time report for model 1:" << std::endl << model_1.time_report() << std::endl;
-    std::cout << "time report for model 2:" << std::endl << model_2.time_report() << std::endl;
+    if(auto timed_model = dynamic_cast<mcts_model::TimedModelBase*>(model_1.get()))
+        std::cout << "time report for model 1:" << std::endl << timed_model->time_report() << std::endl;
+    if(auto timed_model = dynamic_cast<mcts_model::TimedModelBase*>(model_2.get()))
+        std::cout << "time report for model 2:" << std::endl << timed_model->time_report() << std::endl;
+    if(auto timed_model = dynamic_cast<mcts_model::TimedModelBase*>(model_1.get()))
+        std::cout << "memory report for model 1:" << std::endl << timed_model->tree_memory.report() << std::endl;
+    if(auto timed_model = dynamic_cast<mcts_model::TimedModelBase*>(model_2.get()))
+        std::cout << "memory report for model 2:" << std::endl << timed_model->tree_memory.report() << std::endl;
+    if(dynamic_cast<mcts_model::TimedModelBase*>(model_1.get()) || dynamic_cast<mcts_model::TimedModelBase*>(model_2.get()))
+        std::cout << "memory report for all trees:" << std::endl << node::TreeMemory::process_report() << std::endl;
+    if(auto timed_model = dynamic_cast<mcts_model::TimedModelBase*>(model_1.get()))
+        std::cout << "reuse report for model 1:" << std::endl << timed_model->reuse_report() << std::endl;
+    if(auto timed_model = dynamic_cast<mcts_model::TimedModelBase*>(model_2.get()))
+        std::cout << "reuse report for model 2:" << std::endl << timed_model->reuse_report() << std::endl;
+    if(auto arena_model = dynamic_cast<mcts_model::ArenaModelBase*>(model_1.get()))
+    {
+        std::cout << "reuse report for model 1:" << std::endl << arena_model->reuse_report() << std::endl;
+        if(TT_SIZE) std::cout << "transposition report for model 1:" << std::endl << arena_model->transposition_report() << std::endl;
+    }
+    if(auto arena_model = dynamic_cast<mcts_model::ArenaModelBase*>(model_2.get()))
+    {
+        std::cout << "reuse report for model 2:" << std::endl << arena_model->reuse_report() << std::endl;
+        if(TT_SIZE) std::cout << "transposition report for model 2:" << std::endl << arena_model->transposition_report() << std::endl;
+    }
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,46 @@
+#include <chess/chess.hpp>
+#include <mcts/node.hpp>
+#include <mcts/match.hpp>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <cstdint>
+
+// Usage: ./match <CONFIG_A> <CONFIG_B> [GAMES] [CONCURRENT_GAMES] [BOOK] [PGN_FILE] [SEED]
+// Plays GAMES games between the players of two config files, CONCURRENT_GAMES at a time
+// BOOK is a file with one FEN per line, "-" plays every game from the start position
+// Games are appended to PGN_FILE as they finish, the match report goes to stdout
+
+int main(int argc, char* argv[])
+{
+    if(argc < 3)
+    {
+        std::cerr << "usage: ./match <CONFIG_A> <CONFIG_B> [GAMES] [CONCURRENT_GAMES] [BOOK] [PGN_FILE] [SEED]" << std::endl;
+        return 1;
+    }
+    std::string a_file{argv[1]};
+    std::string b_file{argv[2]};
+    int games = argc > 3 ? std::stoi(argv[3]) : 100;
+    int concurrent = argc > 4 ? std::stoi(argv[4]) : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    std::string book_file{argc > 5 ? argv[5] : "-"};
+    std::string pgn_file{argc > 6 ? argv[6] : "games.pgn"};
+    std::uint64_t seed = argc > 7 ? std::stoull(argv[7]) : 0;
+
+    std::unordered_map<std::string, int> a_dict = parse_config(a_file);
+    std::unordered_map<std::string, int> b_dict = parse_config(b_file);
+
+    // Scores are shared by every node, the first config sets them
+    chess::init();
+    node::init(a_dict["WIN_SCORE"], a_dict["DRAW_SCORE"], 2.0);
+
+    std::vector<std::string> book{};
+    if(book_file != "-") book = match::load_book(book_file);
+    std::ofstream pgn(pgn_file, std::ios::app);
+
+    match::Runner runner{match::settings_from_config(a_dict, stats_cache::DEFAULT_FILE, parse_config_decimals(a_file)), match::settings_from_config(b_dict, stats_cache::DEFAULT_FILE, parse_config_decimals(b_file)), a_file, b_file, book, seed};
+    std::vector<match::Game> results = runner.run(games, concurrent, pgn);
+    std::cout << runner.report(results) << std::endl;
+    return 0;
+}
\ No newline at end of file
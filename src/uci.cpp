@@ -0,0 +1,30 @@
+#include <chess/chess.hpp>
+#include <mcts/node.hpp>
+#include <mcts/match.hpp>
+#include <mcts/uci.hpp>
+#include <iostream>
+#include <string>
+#include <cstdint>
+
+// Usage: ./uci [CONFIG] [SEED]
+// Speaks UCI on stdin and stdout with the player of a config file, config.txt by default
+// GUIs time the search with go wtime/btime/movetime, go nodes counts MCTS iterations
+
+int main(int argc, char* argv[])
+{
+    std::string config_file{argc > 1 ? argv[1] : "config.txt"};
+    std::uint64_t seed = argc > 2 ? std::stoull(argv[2]) : 0;
+    std::unordered_map<std::string, int> dict = parse_config(config_file);
+
+    chess::init();
+    node::init(dict["WIN_SCORE"], dict["DRAW_SCORE"], 2.0);
+
+    uci::Engine engine{match::settings_from_config(dict, stats_cache::DEFAULT_FILE, parse_config_decimals(config_file)), std::cout, seed};
+    std::string line;
+    while(std::getline(std::cin, line))
+    {
+        if(!line.empty() && line.back() == '\r') line.pop_back();
+        if(!engine.command(line)) break;
+    }
+    return 0;
+}
\ No newline at end of file